@@ -67,6 +67,10 @@
 #include <sys/param.h>
 #endif
 #include <fcntl.h>
+#ifndef NO_MMAP
+#include <sys/mman.h>
+#define USE_MMAP
+#endif
 #endif /*VMS*/
 
 #include <Xm/Xm.h>
@@ -76,6 +80,10 @@
 #include <Xm/Form.h>
 #include <Xm/Label.h>
 
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
 #ifdef HAVE_DEBUG_H
 #include "../debug.h"
 #endif
@@ -88,6 +96,51 @@
    system which is slow to process stat requests (which I'm not sure exists) */
 #define MOD_CHECK_INTERVAL 3000
 
+/* Size of the blocks in which writeBuffer converts and writes text, and the
+   interval (and minimum file size) at which saves report their progress */
+#define WRITE_BLOCK_SIZE 65536
+#define SAVE_PROGRESS_INTERVAL (16*1024*1024)
+
+/* State of writeBuffer as it passes through the text of a buffer */
+typedef struct {
+    FILE *fp;
+    int fileFormat;		/* line endings to write */
+    char nullSubsChar;		/* character to write as a null, or 0 */
+    char *block;		/* converted text waiting to be written */
+    int blockUsed;
+    WindowInfo *progressWindow;	/* window to report progress in, or NULL */
+    int written;		/* count of buffer characters written */
+    int nextReport;
+    char lastChar;		/* last buffer character written */
+} fileWriter;
+
+#ifdef USE_PTHREADS
+/* A backup file being written by a background thread, from a snapshot of
+   the buffer, by WriteBackupFile */
+typedef struct _backupJob {
+    WindowInfo *window;		/* window backed up, NULL once it's closed */
+    char name[MAXPATHLEN];	/* name of the backup file */
+    bufSnapshot *snapshot;	/* text to write */
+    fileWriter writer;
+    int opened;			/* backup file was successfully created */
+    int error;			/* errno of a failure, or 0 on success */
+    int discard;		/* the backup was removed while being written,
+    				   so remove the file once it's finished */
+} backupJob;
+
+/* Pipe on which background threads hand back their finished jobs */
+static int BackupDonePipe[2] = {-1, -1};
+#endif
+
+#ifdef USE_MMAP
+/* A file mapped into memory by doOpen, which the text buffer refers to
+   until it releases the mapping with unmapFileCB */
+typedef struct {
+    void *address;
+    size_t length;
+} fileMapping;
+#endif
+
 static int doSave(WindowInfo *window);
 static void safeClose(WindowInfo *window);
 static int doOpen(WindowInfo *window, const char *name, const char *path,
@@ -105,6 +158,28 @@ static int min(int i1, int i2);
 static void modifiedWindowDestroyedCB(Widget w, XtPointer clientData,
     XtPointer callData);
 static void forceShowLineNumbers(WindowInfo *window);
+static void initWriter(fileWriter *writer, FILE *fp, int fileFormat,
+        char nullSubsChar);
+static int writeBuffer(WindowInfo *window, FILE *fp, int fileFormat,
+        int showProgress);
+static int writeSegmentCB(const char *text, int length, void *cbArg);
+static int writeBlock(fileWriter *writer, const char *text, int length);
+static int flushWriter(fileWriter *writer);
+#ifndef VMS
+static FILE *openTempFile(const char *fullname, char *tempName);
+static void syncDirectory(const char *path);
+#endif
+#ifdef USE_PTHREADS
+static int startBackgroundBackup(WindowInfo *window);
+static void *backupThread(void *arg);
+static void backupDoneCB(XtPointer clientData, int *source, XtInputId *id);
+#endif
+#ifdef USE_MMAP
+static fileMapping *mapFile(FILE *fp, int fileLen);
+static void unmapFileCB(void *cbArg);
+static int convertMappedChunk(const char *text, int length, char *outText,
+        int *outLength, void *cbArg);
+#endif
 
 #ifdef VMS
 void removeVersionNumber(char *fileName);
@@ -359,10 +434,14 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     char fullname[MAXPATHLEN];
     struct stat statbuf;
     int fileLen, readLen;
-    char *fileString, *c;
+    char *fileString = NULL, *c;
     FILE *fp = NULL;
     int fd;
     int resp;
+#ifdef USE_MMAP
+    fileMapping *mapping = NULL;
+    int mappedFormat;
+#endif
     
     /* initialize lock reasons */
     CLEAR_ALL_LOCKS(window->lockReasons);
@@ -486,30 +565,42 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     }
 #endif
     fileLen = statbuf.st_size;
-    
-    /* Allocate space for the whole contents of the file (unfortunately) */
-    fileString = (char *)NEditMalloc(fileLen+1);  /* +1 = space for null */
-    if (fileString == NULL) {
-        fclose(fp);
-        window->filenameSet = FALSE; /* Temp. prevent check for changes. */
-        DialogF(DF_ERR, window->shell, 1, "Error while opening File",
-                "File is too large to edit", "OK");
-        window->filenameSet = TRUE;
-        return FALSE;
-    }
+    readLen = fileLen;
+
+#ifdef USE_MMAP
+    /* Files larger than the threshold set in preferences are mapped into
+       memory rather than read, and the text buffer refers to the mapped
+       pages until they're edited */
+    if (GetPrefMapFileThreshold() > 0 && S_ISREG(statbuf.st_mode) &&
+            fileLen / (1024*1024) >= GetPrefMapFileThreshold())
+        mapping = mapFile(fp, fileLen);
+    if (mapping == NULL)
+#endif
+    {
+        /* Allocate space for the whole contents of the file (unfortunately) */
+        fileString = (char *)NEditMalloc(fileLen+1);  /* +1 = space for null */
+        if (fileString == NULL) {
+            fclose(fp);
+            window->filenameSet = FALSE; /* Temp. prevent check for changes. */
+            DialogF(DF_ERR, window->shell, 1, "Error while opening File",
+                    "File is too large to edit", "OK");
+            window->filenameSet = TRUE;
+            return FALSE;
+        }
 
-    /* Read the file into fileString and terminate with a null */
-    readLen = fread(fileString, sizeof(char), fileLen, fp);
-    if (ferror(fp)) {
-        fclose(fp);
-        window->filenameSet = FALSE; /* Temp. prevent check for changes. */
-        DialogF(DF_ERR, window->shell, 1, "Error while opening File",
-                "Error reading %s:\n%s", "OK", name, errorString());
-        window->filenameSet = TRUE;
-        NEditFree(fileString);
-        return FALSE;
+        /* Read the file into fileString and terminate with a null */
+        readLen = fread(fileString, sizeof(char), fileLen, fp);
+        if (ferror(fp)) {
+            fclose(fp);
+            window->filenameSet = FALSE; /* Temp. prevent check for changes. */
+            DialogF(DF_ERR, window->shell, 1, "Error while opening File",
+                    "Error reading %s:\n%s", "OK", name, errorString());
+            window->filenameSet = TRUE;
+            NEditFree(fileString);
+            return FALSE;
+        }
+        fileString[readLen] = 0;
     }
-    fileString[readLen] = 0;
  
     /* Close the file */
     if (fclose(fp) != 0) {
@@ -530,6 +621,37 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     window->inode = statbuf.st_ino;
     window->fileMissing = FALSE;
 
+#ifdef USE_MMAP
+    /* Hand a mapped file to the text buffer, which converts DOS and Macintosh
+       line endings a chunk at a time, copying only the chunks that change.
+       If it holds nulls and there's no character free to stand in for them,
+       fall back on a copy of the text and the binary file handling below */
+    if (mapping != NULL) {
+        mappedFormat = UNIX_FILE_FORMAT;
+        if (GetPrefForceOSConversion()) {
+            window->fileFormat = FormatOfFile(mapping->address);
+            mappedFormat = window->fileFormat;
+        }
+        window->ignoreModify = True;
+        if (BufSetAllExternal(window->buffer, mapping->address, fileLen,
+                convertMappedChunk, &mappedFormat, unmapFileCB, mapping)) {
+            window->ignoreModify = False;
+            goto textLoaded;
+        }
+        window->ignoreModify = False;
+        fileString = (char *)NEditMalloc(fileLen+1);
+        if (fileString == NULL) {
+            unmapFileCB(mapping);
+            DialogF(DF_ERR, window->shell, 1, "Error while opening File",
+                    "File is too large to edit", "OK");
+            return FALSE;
+        }
+        memcpy(fileString, mapping->address, fileLen);
+        fileString[fileLen] = 0;
+        unmapFileCB(mapping);
+    }
+#endif
+
     /* Detect and convert DOS and Macintosh format files */
     if (GetPrefForceOSConversion()) {
         window->fileFormat = FormatOfFile(fileString);
@@ -575,6 +697,9 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     /* Release the memory that holds fileString */
     NEditFree(fileString);
 
+#ifdef USE_MMAP
+textLoaded:
+#endif
     /* Set window title and file changed flag */
     if ((flags & PREF_READ_ONLY) != 0) {
         SET_USER_LOCKED(window->lockReasons, TRUE);
@@ -929,11 +1054,10 @@ int SaveWindowAs(WindowInfo *window, const char *newName, int addWrap)
 
 static int doSave(WindowInfo *window)
 {
-    char *fileString = NULL;
-    char fullname[MAXPATHLEN];
+    char fullname[MAXPATHLEN], tempName[MAXPATHLEN];
     struct stat statbuf;
-    FILE *fp;
-    int fileLen, result;
+    FILE *fp = NULL;
+    int result;
 
     /* Get the full name of the file */
     strcpy(fullname, window->path);
@@ -973,13 +1097,26 @@ static int doSave(WindowInfo *window)
     {
         BufInsert(window->buffer, window->buffer->length, "\n");
     }
-    
-    /* open the file */
+
+    /* Write to a temporary file which replaces the original only once it
+       has been completely written, if that can be done without changing the
+       file's ownership or breaking its links.  Otherwise write in place. */
+    tempName[0] = '\0';
+#ifndef VMS
+    fp = openTempFile(fullname, tempName);
+#endif
+    if (fp == NULL) {
+        /* The buffer may still refer to the pages of a large file mapped
+           into memory when it was opened, which truncating the file would
+           pull out from under it */
+        BufCopyExternalText(window->buffer);
+        
 #ifdef VMS
-    fp = fopen(fullname, "w", "rfm = stmlf");
+        fp = fopen(fullname, "w", "rfm = stmlf");
 #else
-    fp = fopen(fullname, "wb");
+        fp = fopen(fullname, "wb");
 #endif /* VMS */
+    }
     if (fp == NULL)
     {
         result = DialogF(DF_WARN, window->shell, 2, "Error saving File",
@@ -999,40 +1136,15 @@ static int doSave(WindowInfo *window)
     fgetname(fp, fullname);
 #endif
     
-    /* get the text buffer contents and its length */
-    fileString = BufGetAll(window->buffer);
-    fileLen = window->buffer->length;
-    
-    /* If null characters are substituted for, put them back */
-    BufUnsubstituteNullChars(fileString, window->buffer);
-    
-    /* If the file is to be saved in DOS or Macintosh format, reconvert */
-    if (window->fileFormat == DOS_FILE_FORMAT)
-    {
-        if (!ConvertToDosFileString(&fileString, &fileLen))
-        {
-            DialogF(DF_ERR, window->shell, 1, "Out of Memory",
-                    "Out of memory!  Try\nsaving in Unix format", "OK");
-            return FALSE;
-        }
-    } else if (window->fileFormat == MAC_FILE_FORMAT)
-    {
-        ConvertToMacFileString(fileString, fileLen);
-    }
-
-    /* write to the file */
-#ifdef IBM_FWRITE_BUG
-    write(fileno(fp), fileString, fileLen);
-#else
-    fwrite(fileString, sizeof(char), fileLen, fp);
-#endif
-    if (ferror(fp))
+    /* write the buffer contents to the file, converting line endings and
+       putting back substituted nulls as it goes */
+    if (!writeBuffer(window, fp, window->fileFormat, True) || fflush(fp) != 0
+            || (GetPrefSyncOnSave() && fsync(fileno(fp)) != 0))
     {
         DialogF(DF_ERR, window->shell, 1, "Error saving File",
                 "%s not saved:\n%s", "OK", window->filename, errorString());
         fclose(fp);
-        remove(fullname);
-        NEditFree(fileString);
+        remove(tempName[0] != '\0' ? tempName : fullname);
         return FALSE;
     }
     
@@ -1041,13 +1153,28 @@ static int doSave(WindowInfo *window)
     {
         DialogF(DF_ERR, window->shell, 1, "Error closing File",
                 "Error closing file:\n%s", "OK", errorString());
-        NEditFree(fileString);
+        if (tempName[0] != '\0')
+            remove(tempName);
         return FALSE;
     }
 
-    /* free the text buffer copy returned from XmTextGetString */
-    NEditFree(fileString);
-    
+#ifndef VMS
+    /* replace the original with the new version */
+    if (tempName[0] != '\0')
+    {
+        if (rename(tempName, fullname) != 0)
+        {
+            DialogF(DF_ERR, window->shell, 1, "Error saving File",
+                    "%s not saved:\n%s", "OK", window->filename,
+                    errorString());
+            remove(tempName);
+            return FALSE;
+        }
+        if (GetPrefSyncOnSave())
+            syncDirectory(window->path);
+    }
+#endif
+
 #ifdef VMS
     /* reflect the fact that NEdit is now editing a new version of the file */
     ParseFilename(fullname, window->filename, window->path);
@@ -1081,11 +1208,17 @@ static int doSave(WindowInfo *window)
 */
 int WriteBackupFile(WindowInfo *window)
 {
-    char *fileString = NULL;
     char name[MAXPATHLEN];
     FILE *fp;
-    int fd, fileLen;
+    int fd, length;
     
+#ifdef USE_PTHREADS
+    /* Leave the work to a background thread if possible, so that typing
+       isn't held up by a large file or a slow disk */
+    if (startBackgroundBackup(window))
+        return TRUE;
+#endif
+
     /* Generate a name for the autoSave file */
     backupFileName(window, name, sizeof(name));
 
@@ -1117,24 +1250,12 @@ int WriteBackupFile(WindowInfo *window)
     chmod(name, S_IRUSR | S_IWUSR);
 #endif
 
-    /* get the text buffer contents and its length */
-    fileString = BufGetAll(window->buffer);
-    fileLen = window->buffer->length;
-    
-    /* If null characters are substituted for, put them back */
-    BufUnsubstituteNullChars(fileString, window->buffer);
-    
-    /* add a terminating newline if the file doesn't already have one */
-    if (fileLen != 0 && fileString[fileLen-1] != '\n')
-    	fileString[fileLen++] = '\n'; 	 /* null terminator no longer needed */
-    
-    /* write out the file */
-#ifdef IBM_FWRITE_BUG
-    write(fileno(fp), fileString, fileLen);
-#else
-    fwrite(fileString, sizeof(char), fileLen, fp);
-#endif
-    if (ferror(fp))
+    /* write out the buffer contents, putting back substituted nulls, and
+       add a terminating newline if the file doesn't already have one */
+    length = window->buffer->length;
+    if (!writeBuffer(window, fp, UNIX_FILE_FORMAT, False) || (length != 0
+            && BufGetCharacter(window->buffer, length - 1) != '\n'
+            && fputc('\n', fp) == EOF) || fflush(fp) != 0)
     {
         DialogF(DF_ERR, window->shell, 1, "Error saving Backup",
                 "Error while saving backup for %s:\n%s\n"
@@ -1142,20 +1263,15 @@ int WriteBackupFile(WindowInfo *window)
                 errorString());
         fclose(fp);
         remove(name);
-        NEditFree(fileString);
         window->autoSave = FALSE;
         return FALSE;
     }
     
     /* close the backup file */
     if (fclose(fp) != 0) {
-	NEditFree(fileString);
 	return FALSE;
     }
 
-    /* Free the text buffer copy returned from XmTextGetString */
-    NEditFree(fileString);
-
     return TRUE;
 }
 
@@ -1170,10 +1286,33 @@ void RemoveBackupFile(WindowInfo *window)
     if (window->autoSave == FALSE)
         return;
       
+#ifdef USE_PTHREADS
+    /* A backup still being written is removed once it's finished */
+    if (window->backupJob != NULL) {
+        window->backupJob->discard = TRUE;
+        window->backupPending = FALSE;
+    }
+#endif
+
     backupFileName(window, name, sizeof(name));
     remove(name);
 }
 
+/*
+** Called when "window" is closed, lets any backup of it still being written
+** in the background finish without it
+*/
+void DetachBackgroundBackup(WindowInfo *window)
+{
+#ifdef USE_PTHREADS
+    if (window->backupJob != NULL) {
+        window->backupJob->window = NULL;
+        window->backupJob = NULL;
+    }
+    window->backupPending = FALSE;
+#endif
+}
+
 /*
 ** Generate the name of the backup file for this window from the filename
 ** and path in the window data structure & write into name
@@ -2114,6 +2253,430 @@ static void forceShowLineNumbers(WindowInfo *window)
     }
 }
 
+/*
+** Write the text of "window"'s buffer to "fp", converting line endings to
+** "fileFormat" and restoring any substituted nulls on the way, without
+** making a copy of the whole text.  If "showProgress" is set, saves of large
+** files report their progress in the statistics line.  Returns False if
+** there was an error writing, with errno set.
+*/
+static int writeBuffer(WindowInfo *window, FILE *fp, int fileFormat,
+        int showProgress)
+{
+    fileWriter writer;
+    char message[MAXPATHLEN + 32];
+    int success;
+
+    initWriter(&writer, fp, fileFormat, window->buffer->nullSubsChar);
+
+    /* Don't take over the statistics line if it's showing something else */
+    if (showProgress && window->buffer->length >= SAVE_PROGRESS_INTERVAL &&
+            !window->modeMessageDisplayed) {
+        writer.progressWindow = window;
+        sprintf(message, "Saving %s...", window->filename);
+        SetModeMessage(window, message);
+        XmUpdateDisplay(window->statsLine);
+    }
+
+    success = BufForEachSegment(window->buffer, 0, window->buffer->length,
+            writeSegmentCB, &writer) && flushWriter(&writer);
+
+    if (writer.progressWindow != NULL)
+        ClearModeMessage(window);
+    NEditFree(writer.block);
+    return success;
+}
+
+/*
+** Prepare "writer" to write buffer text to "fp" (which may be filled in
+** later), converting line endings to "fileFormat" and "nullSubsChar" to
+** nulls.  Free its block with NEditFree when done.
+*/
+static void initWriter(fileWriter *writer, FILE *fp, int fileFormat,
+        char nullSubsChar)
+{
+    writer->fp = fp;
+    writer->fileFormat = fileFormat;
+    writer->nullSubsChar = nullSubsChar;
+    writer->blockUsed = 0;
+    writer->progressWindow = NULL;
+    writer->written = 0;
+    writer->nextReport = SAVE_PROGRESS_INTERVAL;
+    writer->lastChar = '\0';
+
+    /* Unless the text needs no conversion at all, it's converted a block at
+       a time */
+    if (fileFormat != UNIX_FILE_FORMAT || nullSubsChar != '\0')
+        writer->block = (char *)NEditMalloc(WRITE_BLOCK_SIZE);
+    else
+        writer->block = NULL;
+}
+
+/*
+** Segment callback for writeBuffer, writes a run of buffer text in blocks,
+** reporting progress between them
+*/
+static int writeSegmentCB(const char *text, int length, void *cbArg)
+{
+    fileWriter *writer = (fileWriter *)cbArg;
+    char message[MAXPATHLEN + 32];
+    int chunk;
+
+    while (length > 0) {
+        chunk = min(length, WRITE_BLOCK_SIZE);
+        if (!writeBlock(writer, text, chunk))
+            return False;
+        writer->lastChar = text[chunk - 1];
+        text += chunk;
+        length -= chunk;
+        writer->written += chunk;
+        if (writer->progressWindow != NULL &&
+                writer->written >= writer->nextReport) {
+            sprintf(message, "Saving %s... %d%%",
+                    writer->progressWindow->filename, (int)((double)
+                    writer->written * 100 /
+                    writer->progressWindow->buffer->length));
+            SetModeMessage(writer->progressWindow, message);
+            XmUpdateDisplay(writer->progressWindow->statsLine);
+            writer->nextReport += SAVE_PROGRESS_INTERVAL;
+        }
+    }
+    return True;
+}
+
+/*
+** Convert "length" characters of buffer text at "text" for writing, and add
+** them to the writer's block, writing the block out as it fills.  Text that
+** needs no conversion is written as it stands.
+*/
+static int writeBlock(fileWriter *writer, const char *text, int length)
+{
+    const char *c, *end = text + length;
+    char *out;
+
+    if (writer->block == NULL) {
+#ifdef IBM_FWRITE_BUG
+        return write(fileno(writer->fp), text, length) == length;
+#else
+        return fwrite(text, sizeof(char), length, writer->fp) ==
+                (size_t)length;
+#endif
+    }
+    for (c = text; c < end; c++) {
+        /* leave room for the two characters of a DOS line ending */
+        if (writer->blockUsed > WRITE_BLOCK_SIZE - 2 && !flushWriter(writer))
+            return False;
+        out = &writer->block[writer->blockUsed];
+        if (*c == '\n' && writer->fileFormat == DOS_FILE_FORMAT) {
+            *out++ = '\r';
+            *out = '\n';
+            writer->blockUsed += 2;
+            continue;
+        }
+        if (*c == '\n' && writer->fileFormat == MAC_FILE_FORMAT)
+            *out = '\r';
+        else if (*c == writer->nullSubsChar && *c != '\0')
+            *out = '\0';
+        else
+            *out = *c;
+        writer->blockUsed++;
+    }
+    return True;
+}
+
+/*
+** Write out any converted text waiting in the writer's block
+*/
+static int flushWriter(fileWriter *writer)
+{
+    int length = writer->blockUsed;
+
+    writer->blockUsed = 0;
+    if (length == 0)
+        return True;
+#ifdef IBM_FWRITE_BUG
+    return write(fileno(writer->fp), writer->block, length) == length;
+#else
+    return fwrite(writer->block, sizeof(char), length, writer->fp) ==
+            (size_t)length;
+#endif
+}
+
+#ifndef VMS
+/*
+** Create a file in the same directory as "fullname", to write a new version
+** of it to which can be renamed over it once complete, so that a failed save
+** never leaves it half written.  The name of the file is returned in
+** "tempName" (of size MAXPATHLEN), and it's given the permissions and
+** ownership of the original.  Returns NULL if that can't be done faithfully
+** (the original is a symbolic link or has other hard links, the directory
+** isn't writable, or the ownership can't be kept), in which case the caller
+** should write the original in place.
+*/
+static FILE *openTempFile(const char *fullname, char *tempName)
+{
+    struct stat statbuf, tempStat;
+    mode_t mask;
+    FILE *fp;
+    int fd;
+
+    if (lstat(fullname, &statbuf) == 0) {
+        if (!S_ISREG(statbuf.st_mode) || statbuf.st_nlink != 1)
+            return NULL;
+    } else if (errno == ENOENT) {
+        /* a new file, which gets the default permissions */
+        mask = umask(0);
+        umask(mask);
+        statbuf.st_mode = 0666 & ~mask;
+        statbuf.st_uid = (uid_t)-1;
+    } else {
+        return NULL;
+    }
+    
+    if (strlen(fullname) + 8 > MAXPATHLEN)
+        return NULL;
+    sprintf(tempName, "%s.XXXXXX", fullname);
+    if ((fd = mkstemp(tempName)) < 0) {
+        tempName[0] = '\0';
+        return NULL;
+    }
+    
+    if (statbuf.st_uid != (uid_t)-1) {
+        /* only root can give a file away, but the group may still be kept,
+           and the owner may already be right */
+        if ((fchown(fd, statbuf.st_uid, statbuf.st_gid) != 0 &&
+                fchown(fd, (uid_t)-1, statbuf.st_gid) != 0) ||
+                fstat(fd, &tempStat) != 0 ||
+                tempStat.st_uid != statbuf.st_uid ||
+                tempStat.st_gid != statbuf.st_gid) {
+            close(fd);
+            remove(tempName);
+            tempName[0] = '\0';
+            return NULL;
+        }
+    }
+    if (fchmod(fd, statbuf.st_mode & 07777) != 0 ||
+            (fp = fdopen(fd, "wb")) == NULL) {
+        close(fd);
+        remove(tempName);
+        tempName[0] = '\0';
+        return NULL;
+    }
+    return fp;
+}
+
+/*
+** Flush the directory entries of "path" to disk, so that a file just renamed
+** into it survives a crash
+*/
+static void syncDirectory(const char *path)
+{
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return;
+    fsync(fd);
+    close(fd);
+}
+#endif /* VMS */
+
+#ifdef USE_PTHREADS
+/*
+** Start writing the backup file for "window" from a snapshot of its buffer
+** on a background thread.  If one is already being written, another is
+** started when it finishes.  Returns False if a thread can't be started, in
+** which case the caller should write the backup itself.
+*/
+static int startBackgroundBackup(WindowInfo *window)
+{
+    static int inputAdded = FALSE;
+    pthread_attr_t attr;
+    pthread_t thread;
+    backupJob *job;
+    int started;
+
+    if (window->backupJob != NULL) {
+        window->backupPending = TRUE;
+        return TRUE;
+    }
+
+    /* Finished jobs come back to the main loop through a pipe */
+    if (BackupDonePipe[0] == -1 && pipe(BackupDonePipe) != 0) {
+        BackupDonePipe[0] = -1;
+        return FALSE;
+    }
+    if (!inputAdded) {
+        XtAppAddInput(XtWidgetToApplicationContext(window->shell),
+                BackupDonePipe[0], (XtPointer)XtInputReadMask, backupDoneCB,
+                NULL);
+        inputAdded = TRUE;
+    }
+
+    job = (backupJob *)NEditMalloc(sizeof(backupJob));
+    job->window = window;
+    backupFileName(window, job->name, sizeof(job->name));
+    job->snapshot = BufCreateSnapshot(window->buffer);
+    initWriter(&job->writer, NULL, UNIX_FILE_FORMAT,
+            window->buffer->nullSubsChar);
+    job->opened = FALSE;
+    job->error = 0;
+    job->discard = FALSE;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    started = pthread_create(&thread, &attr, backupThread, job) == 0;
+    pthread_attr_destroy(&attr);
+    if (!started) {
+        BufFreeSnapshot(job->snapshot);
+        NEditFree(job->writer.block);
+        NEditFree(job);
+        return FALSE;
+    }
+    window->backupJob = job;
+    window->backupPending = FALSE;
+    return TRUE;
+}
+
+/*
+** Body of the backup thread: writes the backup file described by the
+** backupJob "arg" just as WriteBackupFile does, and hands the job back to
+** the main loop.  Touches nothing but the job.
+*/
+static void *backupThread(void *arg)
+{
+    backupJob *job = (backupJob *)arg;
+    FILE *fp = NULL;
+    int fd;
+
+    remove(job->name);
+    if ((fd = open(job->name, O_CREAT|O_EXCL|O_WRONLY, S_IRUSR | S_IWUSR)) < 0
+            || (fp = fdopen(fd, "w")) == NULL) {
+        job->error = errno;
+        if (fd >= 0)
+            close(fd);
+    } else {
+        job->opened = TRUE;
+        job->writer.fp = fp;
+        if (!BufSnapshotForEachSegment(job->snapshot, writeSegmentCB,
+                &job->writer) || !flushWriter(&job->writer) ||
+                (job->writer.written != 0 && job->writer.lastChar != '\n'
+                && fputc('\n', fp) == EOF) || fflush(fp) != 0)
+            job->error = errno != 0 ? errno : EIO;
+        if (fclose(fp) != 0 && job->error == 0)
+            job->error = errno != 0 ? errno : EIO;
+        if (job->error != 0)
+            remove(job->name);
+    }
+
+    while (write(BackupDonePipe[1], &job, sizeof(job)) < 0 && errno == EINTR)
+        ;
+    return NULL;
+}
+
+/*
+** Input callback for the pipe on which backup threads return their jobs.
+** Reports errors as WriteBackupFile would, and starts the next backup of the
+** window if one became due while this one was being written.
+*/
+static void backupDoneCB(XtPointer clientData, int *source, XtInputId *id)
+{
+    backupJob *job;
+    WindowInfo *window;
+
+    if (read(*source, &job, sizeof(job)) != sizeof(job))
+        return;
+    BufFreeSnapshot(job->snapshot);
+    NEditFree(job->writer.block);
+    window = job->window;
+    if (window != NULL)
+        window->backupJob = NULL;
+
+    if (job->discard) {
+        remove(job->name);
+    } else if (window != NULL && job->error != 0) {
+        errno = job->error;
+        if (!job->opened) {
+            DialogF(DF_WARN, window->shell, 1, "Error writing Backup",
+                    "Unable to save backup for %s:\n%s\n"
+                    "Automatic backup is now off", "OK", window->filename,
+                    errorString());
+            SetToggleButtonState(window, window->autoSaveItem, FALSE, FALSE);
+        } else {
+            DialogF(DF_ERR, window->shell, 1, "Error saving Backup",
+                    "Error while saving backup for %s:\n%s\n"
+                    "Automatic backup is now off", "OK", window->filename,
+                    errorString());
+        }
+        window->autoSave = FALSE;
+        window->backupPending = FALSE;
+    }
+    NEditFree(job);
+
+    if (window != NULL && window->backupPending && window->autoSave)
+        WriteBackupFile(window);
+}
+#endif /* USE_PTHREADS */
+
+#ifdef USE_MMAP
+/*
+** Map the file open on "fp", of length "fileLen", into memory for reading.
+** Returns NULL if the system can't map it, in which case the caller should
+** read it instead.  Free the mapping with unmapFileCB.
+*/
+static fileMapping *mapFile(FILE *fp, int fileLen)
+{
+    fileMapping *mapping;
+    void *address;
+
+    if (fileLen <= 0)
+        return NULL;
+    address = mmap(NULL, fileLen, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (address == MAP_FAILED)
+        return NULL;
+    mapping = (fileMapping *)NEditMalloc(sizeof(fileMapping));
+    if (mapping == NULL) {
+        munmap(address, fileLen);
+        return NULL;
+    }
+    mapping->address = address;
+    mapping->length = fileLen;
+    return mapping;
+}
+
+/*
+** Release callback for BufSetAllExternal, unmaps a file mapped by mapFile
+*/
+static void unmapFileCB(void *cbArg)
+{
+    fileMapping *mapping = (fileMapping *)cbArg;
+
+    munmap(mapping->address, mapping->length);
+    NEditFree(mapping);
+}
+
+/*
+** Filter callback for BufSetAllExternal, converts a chunk of a mapped DOS or
+** Macintosh format file to Unix line endings.  cbArg points to the file
+** format.  Returns False, leaving the chunk to be used in place, if the
+** chunk doesn't need converting.
+*/
+static int convertMappedChunk(const char *text, int length, char *outText,
+        int *outLength, void *cbArg)
+{
+    int format = *(int *)cbArg;
+
+    if (format == UNIX_FILE_FORMAT || memchr(text, '\r', length) == NULL)
+        return False;
+    memcpy(outText, text, length);
+    *outLength = length;
+    if (format == DOS_FILE_FORMAT)
+        ConvertFromDosFileString(outText, outLength, NULL);
+    else
+        ConvertFromMacFileString(outText, length);
+    return True;
+}
+#endif /* USE_MMAP */
+
 static int min(int i1, int i2)
 {
     return i1 <= i2 ? i1 : i2;
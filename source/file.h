@@ -59,6 +59,7 @@ int PromptForNewFile(WindowInfo *window, char *prompt, char *fullname,
     	int *fileFormat, int *addWrap);
 int CheckReadOnly(WindowInfo *window);
 void RemoveBackupFile(WindowInfo *window);
+void DetachBackgroundBackup(WindowInfo *window);
 void UniqueUntitledName(char *name);
 void CheckForChangesToFile(WindowInfo *window);
 
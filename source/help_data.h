@@ -4249,6 +4249,35 @@ static char * htxt_resources [] = {
 "NEdit will try to detect these cases and just pop up the already opened ",
 "document. ",
 "\n\n",
+"\01A\01Bnedit.bufferStorage\01A: GapBuffer\n",
+"\01I\n",
+"How the text of newly created documents is held in memory. \01KGapBuffer\01I ",
+"keeps the text in one block with a movable hole at the editing position, ",
+"which is fastest for ordinary typing. \01KPieceTable\01I keeps the text in many ",
+"small blocks described by a balanced tree, so that edits at widely scattered ",
+"positions (as from macros or Replace All) and line number calculations stay ",
+"fast in very large files, and no single allocation of the size of the file ",
+"is needed. ",
+"\n\n",
+"\01A\01Bnedit.mapFileThreshold\01A: 32\n",
+"\01I\n",
+"Size in megabytes at which files are mapped into memory rather than read ",
+"when they are opened, so that even very large files open almost at once. ",
+"The document then uses piece table storage (see bufferStorage), and ",
+"refers to the mapped file until its text is edited.  If another program ",
+"rewrites such a file while NEdit has it open, NEdit may crash, so set this ",
+"to 0 to always read files in full.  Not available on VMS. ",
+"\n\n",
+"\01A\01Bnedit.syncOnSave\01A: True\n",
+"\01I\n",
+"Files are saved by writing a new copy beside the original and renaming it ",
+"into place, so an interrupted save never leaves a file half written. ",
+"(Files which are symbolic links, have other hard links, or whose owner ",
+"NEdit can't preserve, are still written in place.)  When this is True, ",
+"NEdit also waits for the new copy to reach the disk before replacing the ",
+"original, which protects against losing both versions in a system crash ",
+"but can make saving slow on some file systems. ",
+"\n\n",
 "\01A\01Bnc.autoStart\01A: True \n",
 "\01I\n",
 "Whether the nc program should automatically start an NEdit server (without ",
@@ -1034,13 +1034,13 @@ static void freePatterns(highlightDataRec *patterns)
     
     for (i=0; patterns[i].style!=0; i++) {
     	if (patterns[i].startRE != NULL)
-    	    free((char *)patterns[i].startRE);
+    	    FreeRE(patterns[i].startRE);
     	if (patterns[i].endRE != NULL)
-    	    free((char *)patterns[i].endRE);
+    	    FreeRE(patterns[i].endRE);
     	if (patterns[i].errorRE != NULL)
-    	    free((char *)patterns[i].errorRE);
+    	    FreeRE(patterns[i].errorRE);
     	if (patterns[i].subPatternRE != NULL)
-    	    free((char *)patterns[i].subPatternRE);
+    	    FreeRE(patterns[i].subPatternRE);
     }
 
     for (i=0; patterns[i].style!=0; i++) {
@@ -0,0 +1,337 @@
+/*******************************************************************************
+*                                                                              *
+* lineIndex.c -- Incrementally maintained newline index for text buffers       *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute version of this program linked to   *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License        *
+* for more details.                                                            *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** The line index divides the text of a buffer into consecutive chunks of
+** roughly LINE_INDEX_CHUNK characters, and records the length and number of
+** newlines of each.  Both are also kept in Fenwick (binary indexed) trees, so
+** that the chunk holding a given position or a given newline, and the totals
+** preceding it, can be found in O(log n) time.  The owner of the text keeps
+** the index up to date by reporting every insertion and deletion, which only
+** adjusts the counts of the chunks involved.  Chunks which have grown too
+** large or become empty are re-balanced lazily, on the next query.
+**
+** The index holds no text, so answers are in terms of chunks: the owner
+** finishes off a query by scanning the (short) chunk itself.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "lineIndex.h"
+#include "../util/nedit_malloc.h"
+
+#include <stdlib.h>
+
+#ifdef HAVE_DEBUG_H
+#include "../debug.h"
+#endif
+
+#define LINE_INDEX_CHUNK 8192	/* nominal size of an indexed chunk of text */
+
+struct _LineIndex {
+    int nChunks;		/* number of chunks the text is divided in */
+    int *length;		/* length of each chunk */
+    int *nNewlines;		/* newlines in each chunk */
+    int *lengthTree;		/* Fenwick trees over length and nNewlines */
+    int *newlineTree;		/*   (these are indexed from 1) */
+    int topBit;			/* largest power of 2 <= nChunks */
+    int needsRebalance;		/* chunks are oversized or empty */
+    lineIndexCountProc countProc;
+    void *countArg;
+};
+
+static void allocChunks(LineIndex *index, int nChunks);
+static void buildTrees(LineIndex *index);
+static void rebalance(LineIndex *index);
+static void treeAdd(int *tree, int nChunks, int chunk, int delta);
+static int treeSum(const int *tree, int chunk);
+static int treeSearch(const int *tree, int nChunks, int topBit, int target,
+	int *sumBefore);
+static int findChunk(LineIndex *index, int pos, int *chunkStart);
+
+/*
+** Create an index for a text of length "textLength", using "countProc" to
+** count the newlines in it
+*/
+LineIndex *LineIndexCreate(int textLength, lineIndexCountProc countProc,
+        void *countArg)
+{
+    LineIndex *index = NEditNew(LineIndex);
+    int i, nChunks = textLength / LINE_INDEX_CHUNK + 1;
+
+    index->countProc = countProc;
+    index->countArg = countArg;
+    index->needsRebalance = 0;
+    allocChunks(index, nChunks);
+    for (i = 0; i < nChunks; i++) {
+        index->length[i] = i < nChunks - 1 ? LINE_INDEX_CHUNK :
+                textLength - i * LINE_INDEX_CHUNK;
+        index->nNewlines[i] = countProc(countArg, i * LINE_INDEX_CHUNK,
+                i * LINE_INDEX_CHUNK + index->length[i]);
+    }
+    buildTrees(index);
+    return index;
+}
+
+void LineIndexFree(LineIndex *index)
+{
+    NEditFree(index->length);
+    NEditFree(index->nNewlines);
+    NEditFree(index->lengthTree);
+    NEditFree(index->newlineTree);
+    NEditFree(index);
+}
+
+/*
+** Account for the insertion of "nInserted" characters, "nNewlines" of them
+** newlines, at position "pos"
+*/
+void LineIndexInsert(LineIndex *index, int pos, int nInserted, int nNewlines)
+{
+    int chunkStart, chunk = findChunk(index, pos, &chunkStart);
+
+    index->length[chunk] += nInserted;
+    index->nNewlines[chunk] += nNewlines;
+    treeAdd(index->lengthTree, index->nChunks, chunk, nInserted);
+    treeAdd(index->newlineTree, index->nChunks, chunk, nNewlines);
+    if (index->length[chunk] > 2 * LINE_INDEX_CHUNK)
+        index->needsRebalance = 1;
+}
+
+/*
+** Account for the deletion of the text between "start" and "end".  This
+** must be called BEFORE the text is removed, since counting the newlines
+** removed from partially deleted chunks needs the text.
+*/
+void LineIndexDelete(LineIndex *index, int start, int end)
+{
+    int chunkStart, chunkEnd, delStart, delEnd, nDeleted, nNewlines;
+    int chunk = findChunk(index, start, &chunkStart);
+
+    while (chunk < index->nChunks && chunkStart < end) {
+        chunkEnd = chunkStart + index->length[chunk];
+        delStart = start > chunkStart ? start : chunkStart;
+        delEnd = end < chunkEnd ? end : chunkEnd;
+        nDeleted = delEnd - delStart;
+        if (nDeleted == index->length[chunk])
+            nNewlines = index->nNewlines[chunk];
+        else if (nDeleted > 0)
+            nNewlines = index->countProc(index->countArg, delStart, delEnd);
+        else
+            nNewlines = 0;
+        index->length[chunk] -= nDeleted;
+        index->nNewlines[chunk] -= nNewlines;
+        treeAdd(index->lengthTree, index->nChunks, chunk, -nDeleted);
+        treeAdd(index->newlineTree, index->nChunks, chunk, -nNewlines);
+        if (index->length[chunk] == 0)
+            index->needsRebalance = 1;
+        chunkStart = chunkEnd;
+        chunk++;
+    }
+}
+
+int LineIndexTotalNewlines(LineIndex *index)
+{
+    return treeSum(index->newlineTree, index->nChunks);
+}
+
+/*
+** Return the number of newlines which precede the chunk holding position
+** "pos", and the position where that chunk begins in "chunkStart".  The
+** caller adds the newlines between chunkStart and pos.
+*/
+int LineIndexNewlinesBefore(LineIndex *index, int pos, int *chunkStart)
+{
+    int chunk;
+
+    if (index->needsRebalance)
+        rebalance(index);
+    chunk = findChunk(index, pos, chunkStart);
+    return treeSum(index->newlineTree, chunk);
+}
+
+/*
+** Find the chunk holding newline number "lineNum" (counting from 1, which
+** must be no more than LineIndexTotalNewlines).  Returns the position where
+** the chunk begins, and in "nRemaining", which newline of the chunk it is.
+*/
+int LineIndexFindNewline(LineIndex *index, int lineNum, int *nRemaining)
+{
+    int chunk, nlBefore;
+
+    if (index->needsRebalance)
+        rebalance(index);
+    chunk = treeSearch(index->newlineTree, index->nChunks, index->topBit,
+            lineNum, &nlBefore);
+    *nRemaining = lineNum - nlBefore;
+    return treeSum(index->lengthTree, chunk);
+}
+
+/*
+** Find the chunk holding position "pos" (a position at the very end of the
+** text belongs to the last chunk), and where that chunk begins
+*/
+static int findChunk(LineIndex *index, int pos, int *chunkStart)
+{
+    int chunk = treeSearch(index->lengthTree, index->nChunks, index->topBit,
+            pos + 1, chunkStart);
+
+    if (chunk >= index->nChunks) {
+        chunk = index->nChunks - 1;
+        *chunkStart = treeSum(index->lengthTree, chunk);
+    }
+    return chunk;
+}
+
+/*
+** Merge chunks which have become small and split those which have grown
+** large, so each is again between roughly 1/2 and 2 times LINE_INDEX_CHUNK
+*/
+static void rebalance(LineIndex *index)
+{
+    int i, pos, len, oldNChunks = index->nChunks, nChunks = 0;
+    int *oldLength = index->length, *oldNewlines = index->nNewlines;
+
+    /* count the chunks needed so the new arrays can be allocated */
+    for (i = 0; i < oldNChunks; i++)
+        nChunks += oldLength[i] / LINE_INDEX_CHUNK + 1;
+    NEditFree(index->lengthTree);
+    NEditFree(index->newlineTree);
+    allocChunks(index, nChunks);
+
+    nChunks = 0;
+    pos = 0;
+    for (i = 0; i < oldNChunks; i++) {
+        len = oldLength[i];
+        if (len > 2 * LINE_INDEX_CHUNK) {
+            /* split an oversized chunk, counting its newlines anew */
+            while (len > 0) {
+                int piece = len > LINE_INDEX_CHUNK ? LINE_INDEX_CHUNK : len;
+                index->length[nChunks] = piece;
+                index->nNewlines[nChunks++] = index->countProc(
+                        index->countArg, pos, pos + piece);
+                pos += piece;
+                len -= piece;
+            }
+        } else if (nChunks > 0 && index->length[nChunks-1] + len <=
+                LINE_INDEX_CHUNK) {
+            /* fold small (or empty) chunks into their predecessor */
+            index->length[nChunks-1] += len;
+            index->nNewlines[nChunks-1] += oldNewlines[i];
+            pos += len;
+        } else {
+            index->length[nChunks] = len;
+            index->nNewlines[nChunks++] = oldNewlines[i];
+            pos += len;
+        }
+    }
+    if (nChunks == 0) {
+        index->length[0] = index->nNewlines[0] = 0;
+        nChunks = 1;
+    }
+    index->nChunks = nChunks;
+    NEditFree(oldLength);
+    NEditFree(oldNewlines);
+    buildTrees(index);
+    index->needsRebalance = 0;
+}
+
+static void allocChunks(LineIndex *index, int nChunks)
+{
+    index->nChunks = nChunks;
+    index->length = (int *)NEditMalloc(sizeof(int) * nChunks);
+    index->nNewlines = (int *)NEditMalloc(sizeof(int) * nChunks);
+    index->lengthTree = (int *)NEditMalloc(sizeof(int) * (nChunks + 1));
+    index->newlineTree = (int *)NEditMalloc(sizeof(int) * (nChunks + 1));
+}
+
+/*
+** Fill in the Fenwick trees from the length and nNewlines arrays in O(n)
+*/
+static void buildTrees(LineIndex *index)
+{
+    int i, parent, n = index->nChunks;
+
+    for (i = 1; i <= n; i++) {
+        index->lengthTree[i] = index->length[i-1];
+        index->newlineTree[i] = index->nNewlines[i-1];
+    }
+    for (i = 1; i <= n; i++) {
+        parent = i + (i & -i);
+        if (parent <= n) {
+            index->lengthTree[parent] += index->lengthTree[i];
+            index->newlineTree[parent] += index->newlineTree[i];
+        }
+    }
+    for (index->topBit = 1; index->topBit * 2 <= n; index->topBit *= 2);
+}
+
+/*
+** Add "delta" to the value of chunk "chunk" (counting from 0) in "tree"
+*/
+static void treeAdd(int *tree, int nChunks, int chunk, int delta)
+{
+    int i;
+
+    if (delta == 0)
+        return;
+    for (i = chunk + 1; i <= nChunks; i += i & -i)
+        tree[i] += delta;
+}
+
+/*
+** Return the sum of the values of the first "chunk" chunks in "tree"
+*/
+static int treeSum(const int *tree, int chunk)
+{
+    int i, sum = 0;
+
+    for (i = chunk; i > 0; i -= i & -i)
+        sum += tree[i];
+    return sum;
+}
+
+/*
+** Find the first chunk at which the running sum of values in "tree" reaches
+** "target", returning the sum of the values of the chunks before it in
+** "sumBefore".  Returns nChunks if the total is less than target.
+*/
+static int treeSearch(const int *tree, int nChunks, int topBit, int target,
+	int *sumBefore)
+{
+    int step, chunk = 0;
+
+    *sumBefore = 0;
+    for (step = topBit; step > 0; step /= 2) {
+        if (chunk + step <= nChunks && tree[chunk + step] < target) {
+            chunk += step;
+            target -= tree[chunk];
+            *sumBefore += tree[chunk];
+        }
+    }
+    return chunk;
+}
@@ -0,0 +1,44 @@
+/*******************************************************************************
+*                                                                              *
+* lineIndex.h -- Nirvana Editor text buffer newline index header               *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef NEDIT_LINEINDEX_H_INCLUDED
+#define NEDIT_LINEINDEX_H_INCLUDED
+
+typedef struct _LineIndex LineIndex;
+
+/* Procedure for counting the newlines between two positions of the indexed
+   text, supplied by the owner of the text */
+typedef int (*lineIndexCountProc)(void *countArg, int start, int end);
+
+LineIndex *LineIndexCreate(int textLength, lineIndexCountProc countProc,
+        void *countArg);
+void LineIndexFree(LineIndex *index);
+void LineIndexInsert(LineIndex *index, int pos, int nInserted, int nNewlines);
+void LineIndexDelete(LineIndex *index, int start, int end);
+int LineIndexTotalNewlines(LineIndex *index);
+int LineIndexNewlinesBefore(LineIndex *index, int pos, int *chunkStart);
+int LineIndexFindNewline(LineIndex *index, int lineNum, int *nRemaining);
+
+#endif /* NEDIT_LINEINDEX_H_INCLUDED */
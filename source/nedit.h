@@ -469,6 +469,10 @@ typedef struct _WindowInfo {
     int		autoSaveCharCount;	/* count of single characters typed
     					   since last backup file generated */
     int		autoSaveOpCount;	/* count of editing operations "" */
+    struct _backupJob *backupJob;	/* backup file being written in the
+    					   background, or NULL */
+    Boolean	backupPending;		/* another backup is due once it's
+    					   written */
     int		undoOpCount;		/* count of stored undo operations */
     int		undoMemUsed;		/* amount of memory (in bytes)
     					   dedicated to the undo list */
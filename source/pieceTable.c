@@ -0,0 +1,814 @@
+/*******************************************************************************
+*                                                                              *
+* pieceTable.c -- Piece table text storage for the text buffer                 *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute version of this program linked to   *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License        *
+* for more details.                                                            *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** The piece table is an alternative to the single gap buffer for holding
+** the text of a textBuffer.  Text lives in fixed size blocks which are never
+** moved once written, and the document is described by an ordered sequence
+** of "pieces", each referring to a run of characters within one block.  The
+** pieces are kept in a treap (a binary search tree balanced by random node
+** priorities) ordered by document position, where every node also carries
+** the total length and newline count of its subtree.  This makes inserting
+** or deleting text anywhere in the document, and locating a position or a
+** line number, O(log n) operations, and no allocation is ever larger than
+** one block.
+**
+** A block may also be "lent" text owned by someone else, such as a memory
+** mapped file.  The table never writes such text: since pieces only refer to
+** text, editing it costs nothing more than editing any other, and a piece of
+** lent text is only copied into the table's own blocks when it has to be
+** changed in place (see PieceTableSubstituteChar).
+**
+** PieceTableSnapshot records the current pieces, holding references to
+** their blocks, so that another thread can read the text as it was while
+** the table goes on being edited.  Inserted text only ever goes into unused
+** parts of blocks, and blocks referred to by a snapshot are treated like
+** lent ones, and not written, until the snapshot is freed.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "pieceTable.h"
+#include "textScan.h"
+#include "../util/nedit_malloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_DEBUG_H
+#include "../debug.h"
+#endif
+
+#define PIECE_BLOCK_SIZE 65536	/* size of the blocks holding text, and so
+				   the maximum length of a single piece */
+
+typedef struct _PieceBlock {
+    int refCount;		/* number of pieces referring to the block */
+    int used;			/* characters of text stored in the block */
+    char *text;
+    int lent;			/* text belongs to someone else: read only */
+    int nSnapshotRefs;		/* pieces of snapshots referring to the block,
+    				   which make it read only as well */
+    pieceReleaseProc releaseProc; /* for lent text, called when the block */
+    void *releaseArg;		/*   is no longer used */
+} PieceBlock;
+
+typedef struct _PieceNode {
+    struct _PieceNode *left;
+    struct _PieceNode *right;
+    unsigned priority;		/* random treap priority (heap ordered) */
+    PieceBlock *block;		/* block holding the text of the piece */
+    int offset;			/* start of the piece within block->text */
+    int length;			/* length of the piece */
+    int nNewlines;		/* newlines within the piece */
+    int subLength;		/* total length of the subtree */
+    int subNewlines;		/* total newlines in the subtree */
+} PieceNode;
+
+/* A run of text recorded by PieceTableSnapshot */
+typedef struct {
+    PieceBlock *block;
+    int offset;
+    int length;
+} SnapshotPiece;
+
+struct _PieceSnapshot {
+    int nPieces;
+    SnapshotPiece *pieces;
+};
+
+struct _PieceTable {
+    PieceNode *root;
+    PieceBlock *addBlock;	/* block currently receiving inserted text */
+    unsigned seed;		/* state of the priority generator */
+    int cacheStart;		/* last piece located by a position lookup, */
+    int cacheLength;		/*   to make sequential access (drawing, */
+    const char *cacheText;	/*   character by character scanning) cheap */
+    char *flat;			/* contiguous copy of the text, kept between
+    				   modifications for PieceTableAsString */
+};
+
+static PieceBlock *newBlock(void);
+static PieceBlock *newLentBlock(const char *text, int length,
+	pieceReleaseProc releaseProc, void *releaseArg);
+static void releaseBlock(PieceBlock *block);
+static PieceNode *newNode(PieceTable *table, PieceBlock *block, int offset,
+	int length, int nNewlines);
+static void freeTree(PieceNode *node);
+static void updateNode(PieceNode *node);
+static PieceNode *merge(PieceNode *left, PieceNode *right);
+static void split(PieceTable *table, PieceNode *node, int pos,
+	PieceNode **left, PieceNode **right);
+static int extendLast(PieceNode *node, PieceBlock *block, int length,
+	int nNewlines);
+static PieceNode *appendText(PieceTable *table, PieceNode *tree,
+	const char *text, int length);
+static PieceNode *findPiece(PieceNode *node, int *pos);
+static int countNewlines(const char *text, int length);
+static void copyPieceText(PieceTable *table, PieceNode *node);
+static void copyLentPieces(PieceTable *table, PieceNode *node);
+static void substituteInTree(PieceTable *table, PieceNode *node,
+	char fromChar, char toChar);
+static int readOnly(PieceBlock *block);
+static int countPieces(PieceNode *node);
+static void snapshotPieces(PieceNode *node, SnapshotPiece **piece);
+static void modified(PieceTable *table);
+
+/*
+** Create an empty piece table
+*/
+PieceTable *PieceTableCreate(void)
+{
+    PieceTable *table = NEditNew(PieceTable);
+
+    table->root = NULL;
+    table->addBlock = NULL;
+    table->seed = 2463534242u;
+    table->cacheText = NULL;
+    table->cacheStart = table->cacheLength = 0;
+    table->flat = NULL;
+    return table;
+}
+
+void PieceTableFree(PieceTable *table)
+{
+    freeTree(table->root);
+    if (table->addBlock != NULL)
+        releaseBlock(table->addBlock);
+    NEditFree(table->flat);
+    NEditFree(table);
+}
+
+int PieceTableLength(const PieceTable *table)
+{
+    return table->root == NULL ? 0 : table->root->subLength;
+}
+
+/*
+** Replace the entire contents of the table with "length" characters of "text"
+*/
+void PieceTableSetAll(PieceTable *table, const char *text, int length)
+{
+    modified(table);
+    freeTree(table->root);
+    if (table->addBlock != NULL)
+        releaseBlock(table->addBlock);
+    table->addBlock = NULL;
+    table->root = appendText(table, NULL, text, length);
+}
+
+/*
+** Replace the entire contents of the table with "length" characters of
+** "text", lent by the caller rather than copied.  The text must stay valid
+** and unchanged until the table calls "releaseProc" (which happens when no
+** piece refers to it any longer, which may be before this returns).
+**
+** The text is taken in chunks of up to a block, each first handed to
+** "filterProc" (if not NULL), which may substitute a modified version to
+** be copied in its place.  So that line ending conversion can be done by
+** chunk, a chunk never ends between a carriage return and the character
+** after it.
+*/
+void PieceTableSetExternal(PieceTable *table, const char *text, int length,
+        pieceFilterProc filterProc, void *filterArg,
+        pieceReleaseProc releaseProc, void *releaseArg)
+{
+    PieceBlock *block;
+    char *filtered;
+    int pos, chunk, filteredLength;
+
+    modified(table);
+    freeTree(table->root);
+    if (table->addBlock != NULL)
+        releaseBlock(table->addBlock);
+    table->addBlock = NULL;
+    table->root = NULL;
+
+    block = newLentBlock(text, length, releaseProc, releaseArg);
+    filtered = (char *)NEditMalloc(PIECE_BLOCK_SIZE + 1);
+    for (pos = 0; pos < length; pos += chunk) {
+        chunk = length - pos < PIECE_BLOCK_SIZE ? length - pos :
+                PIECE_BLOCK_SIZE;
+        if (pos + chunk < length && text[pos + chunk - 1] == '\r')
+            chunk--;
+        if (filterProc != NULL && filterProc(text + pos, chunk, filtered,
+                &filteredLength, filterArg))
+            table->root = appendText(table, table->root, filtered,
+                    filteredLength);
+        else
+            table->root = merge(table->root, newNode(table, block, pos, chunk,
+                    countNewlines(text + pos, chunk)));
+    }
+    NEditFree(filtered);
+    releaseBlock(block);
+}
+
+/*
+** Copy any text lent to the table by PieceTableSetExternal which it still
+** refers to into its own blocks, so the lender can reclaim it
+*/
+void PieceTableCopyExternal(PieceTable *table)
+{
+    copyLentPieces(table, table->root);
+    modified(table);
+}
+
+/*
+** Insert "length" characters of "text" at position "pos"
+*/
+void PieceTableInsert(PieceTable *table, int pos, const char *text,
+        int length)
+{
+    PieceNode *left, *right;
+
+    if (length <= 0)
+        return;
+    modified(table);
+    split(table, table->root, pos, &left, &right);
+    table->root = merge(appendText(table, left, text, length), right);
+}
+
+/*
+** Remove the characters between "start" and "end"
+*/
+void PieceTableDelete(PieceTable *table, int start, int end)
+{
+    PieceNode *left, *middle, *right;
+
+    if (end <= start)
+        return;
+    modified(table);
+    split(table, table->root, start, &left, &right);
+    split(table, right, end - start, &middle, &right);
+    freeTree(middle);
+    table->root = merge(left, right);
+}
+
+/*
+** Return a pointer to the longest run of contiguous text beginning at
+** position "pos", and its length in "segLen".  At the end of the text,
+** returns NULL with a segLen of 0.
+*/
+const char *PieceTableSegment(PieceTable *table, int pos, int *segLen)
+{
+    PieceNode *node;
+    int offset = pos;
+
+    if (table->cacheText != NULL && pos >= table->cacheStart &&
+            pos < table->cacheStart + table->cacheLength) {
+        *segLen = table->cacheStart + table->cacheLength - pos;
+        return table->cacheText + (pos - table->cacheStart);
+    }
+    if (pos < 0 || pos >= PieceTableLength(table)) {
+        *segLen = 0;
+        return NULL;
+    }
+    node = findPiece(table->root, &offset);
+    table->cacheStart = pos - offset;
+    table->cacheLength = node->length;
+    table->cacheText = node->block->text + node->offset;
+    *segLen = node->length - offset;
+    return table->cacheText + offset;
+}
+
+/*
+** Return a pointer to the start of the longest run of contiguous text ending
+** just before position "pos", and its length in "segLen".  At the beginning
+** of the text, returns NULL with a segLen of 0.
+*/
+const char *PieceTableSegmentBefore(PieceTable *table, int pos, int *segLen)
+{
+    if (pos <= 0 || pos > PieceTableLength(table)) {
+        *segLen = 0;
+        return NULL;
+    }
+    PieceTableSegment(table, pos - 1, segLen);
+    *segLen = pos - table->cacheStart;
+    return table->cacheText;
+}
+
+char PieceTableGetChar(PieceTable *table, int pos)
+{
+    int segLen;
+    const char *text = PieceTableSegment(table, pos, &segLen);
+
+    return text == NULL ? '\0' : *text;
+}
+
+/*
+** Copy the text between "start" and "end" to "outStr", which must have room
+** for end - start characters (no terminating null is added)
+*/
+void PieceTableCopyRange(PieceTable *table, int start, int end, char *outStr)
+{
+    const char *text;
+    int segLen;
+
+    while (start < end) {
+        text = PieceTableSegment(table, start, &segLen);
+        if (text == NULL)
+            break;
+        if (segLen > end - start)
+            segLen = end - start;
+        memcpy(outStr, text, segLen);
+        outStr += segLen;
+        start += segLen;
+    }
+}
+
+/*
+** Return the whole text as a single null terminated string.  The string is
+** built on first use and kept until the next modification, so this is only
+** cheap for callers which don't interleave it with changes to the text.
+*/
+const char *PieceTableAsString(PieceTable *table)
+{
+    int length = PieceTableLength(table);
+
+    if (table->flat == NULL) {
+        table->flat = (char*)NEditMalloc(length + 1);
+        PieceTableCopyRange(table, 0, length, table->flat);
+        table->flat[length] = '\0';
+    }
+    return table->flat;
+}
+
+/*
+** Replace all occurrences of "fromChar" with "toChar", in place.  Newline
+** counts are not maintained, so neither character may be a newline.
+*/
+void PieceTableSubstituteChar(PieceTable *table, char fromChar, char toChar)
+{
+    substituteInTree(table, table->root, fromChar, toChar);
+    modified(table);
+}
+
+/*
+** Record the text of the table as it is now, for reading with
+** PieceSnapshotForEachPiece (safe from any thread, while the table is
+** edited) until it's freed with PieceSnapshotFree
+*/
+PieceSnapshot *PieceTableSnapshot(PieceTable *table)
+{
+    PieceSnapshot *snapshot = NEditNew(PieceSnapshot);
+    SnapshotPiece *piece;
+
+    snapshot->nPieces = countPieces(table->root);
+    snapshot->pieces = (SnapshotPiece *)NEditMalloc(sizeof(SnapshotPiece) *
+            (snapshot->nPieces > 0 ? snapshot->nPieces : 1));
+    piece = snapshot->pieces;
+    snapshotPieces(table->root, &piece);
+    return snapshot;
+}
+
+/*
+** Pass the runs of text of "snapshot" in order to "pieceProc", stopping and
+** returning 0 if it returns 0.  Returns 1 if it was passed them all.
+*/
+int PieceSnapshotForEachPiece(const PieceSnapshot *snapshot,
+        pieceTextProc pieceProc, void *cbArg)
+{
+    const SnapshotPiece *piece;
+
+    for (piece = snapshot->pieces;
+            piece < snapshot->pieces + snapshot->nPieces; piece++)
+        if (!pieceProc(piece->block->text + piece->offset, piece->length,
+                cbArg))
+            return 0;
+    return 1;
+}
+
+/*
+** Free a snapshot.  This must be done on the thread which edits the table
+** it came from, as it releases blocks shared with the table.
+*/
+void PieceSnapshotFree(PieceSnapshot *snapshot)
+{
+    SnapshotPiece *piece;
+
+    for (piece = snapshot->pieces;
+            piece < snapshot->pieces + snapshot->nPieces; piece++) {
+        piece->block->nSnapshotRefs--;
+        releaseBlock(piece->block);
+    }
+    NEditFree(snapshot->pieces);
+    NEditFree(snapshot);
+}
+
+/*
+** Count the newlines before position "pos"
+*/
+int PieceTableCountNewlines(PieceTable *table, int pos)
+{
+    PieceNode *node = table->root;
+    int count = 0;
+
+    if (pos >= PieceTableLength(table))
+        return node == NULL ? 0 : node->subNewlines;
+    while (node != NULL && pos > 0) {
+        int leftLen = node->left == NULL ? 0 : node->left->subLength;
+        if (pos <= leftLen) {
+            node = node->left;
+        } else {
+            if (node->left != NULL)
+                count += node->left->subNewlines;
+            pos -= leftLen;
+            if (pos <= node->length)
+                return count + countNewlines(node->block->text + node->offset,
+                        pos);
+            count += node->nNewlines;
+            pos -= node->length;
+            node = node->right;
+        }
+    }
+    return count;
+}
+
+/*
+** Return the position of the first character of line "lineNum" (counting
+** from 0), or the length of the text if it doesn't have that many lines
+*/
+int PieceTableLineStart(PieceTable *table, int lineNum)
+{
+    PieceNode *node = table->root;
+    int pos = 0;
+    const char *text, *c;
+
+    if (lineNum <= 0)
+        return 0;
+    if (node == NULL || lineNum > node->subNewlines)
+        return PieceTableLength(table);
+    while (node != NULL) {
+        int leftNl = node->left == NULL ? 0 : node->left->subNewlines;
+        if (lineNum <= leftNl) {
+            node = node->left;
+            continue;
+        }
+        if (node->left != NULL)
+            pos += node->left->subLength;
+        lineNum -= leftNl;
+        if (lineNum <= node->nNewlines) {
+            text = node->block->text + node->offset;
+            c = ScanFindNthChar(text, node->length, '\n', lineNum, &lineNum);
+            return pos + (c - text) + 1;
+        }
+        lineNum -= node->nNewlines;
+        pos += node->length;
+        node = node->right;
+    }
+    return pos;
+}
+
+/*
+** Drop anything derived from the current text (lookup cache, flat copy)
+*/
+static void modified(PieceTable *table)
+{
+    table->cacheText = NULL;
+    NEditFree(table->flat);
+    table->flat = NULL;
+}
+
+static PieceBlock *newBlock(void)
+{
+    PieceBlock *block = (PieceBlock *)NEditMalloc(sizeof(PieceBlock) +
+            PIECE_BLOCK_SIZE);
+
+    block->refCount = 1;
+    block->used = 0;
+    block->text = (char *)(block + 1);
+    block->lent = 0;
+    block->nSnapshotRefs = 0;
+    block->releaseProc = NULL;
+    block->releaseArg = NULL;
+    return block;
+}
+
+static PieceBlock *newLentBlock(const char *text, int length,
+	pieceReleaseProc releaseProc, void *releaseArg)
+{
+    PieceBlock *block = NEditNew(PieceBlock);
+
+    block->refCount = 1;
+    block->used = length;
+    block->text = (char *)text;
+    block->lent = 1;
+    block->nSnapshotRefs = 0;
+    block->releaseProc = releaseProc;
+    block->releaseArg = releaseArg;
+    return block;
+}
+
+static void releaseBlock(PieceBlock *block)
+{
+    if (--block->refCount != 0)
+        return;
+    if (block->releaseProc != NULL)
+        block->releaseProc(block->releaseArg);
+    NEditFree(block);
+}
+
+static PieceNode *newNode(PieceTable *table, PieceBlock *block, int offset,
+	int length, int nNewlines)
+{
+    PieceNode *node = NEditNew(PieceNode);
+
+    /* xorshift generator, private so as not to disturb users of rand() */
+    table->seed ^= table->seed << 13;
+    table->seed ^= table->seed >> 17;
+    table->seed ^= table->seed << 5;
+    node->priority = table->seed;
+    node->left = node->right = NULL;
+    node->block = block;
+    block->refCount++;
+    node->offset = offset;
+    node->length = node->subLength = length;
+    node->nNewlines = node->subNewlines = nNewlines;
+    return node;
+}
+
+static void freeTree(PieceNode *node)
+{
+    if (node == NULL)
+        return;
+    freeTree(node->left);
+    freeTree(node->right);
+    releaseBlock(node->block);
+    NEditFree(node);
+}
+
+/*
+** Recompute the subtree totals of "node" from its children
+*/
+static void updateNode(PieceNode *node)
+{
+    node->subLength = node->length;
+    node->subNewlines = node->nNewlines;
+    if (node->left != NULL) {
+        node->subLength += node->left->subLength;
+        node->subNewlines += node->left->subNewlines;
+    }
+    if (node->right != NULL) {
+        node->subLength += node->right->subLength;
+        node->subNewlines += node->right->subNewlines;
+    }
+}
+
+/*
+** Concatenate two trees, all of whose text in "left" precedes "right"
+*/
+static PieceNode *merge(PieceNode *left, PieceNode *right)
+{
+    if (left == NULL)
+        return right;
+    if (right == NULL)
+        return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        updateNode(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    updateNode(right);
+    return right;
+}
+
+/*
+** Split the tree "node" into the pieces holding the first "pos" characters
+** ("left") and the rest ("right"), cutting a piece in two if "pos" falls
+** inside it
+*/
+static void split(PieceTable *table, PieceNode *node, int pos,
+	PieceNode **left, PieceNode **right)
+{
+    int leftLen;
+
+    if (node == NULL) {
+        *left = *right = NULL;
+        return;
+    }
+    leftLen = node->left == NULL ? 0 : node->left->subLength;
+    if (pos <= leftLen) {
+        split(table, node->left, pos, left, &node->left);
+        updateNode(node);
+        *right = node;
+    } else if (pos >= leftLen + node->length) {
+        split(table, node->right, pos - leftLen - node->length,
+                &node->right, right);
+        updateNode(node);
+        *left = node;
+    } else {
+        /* cut the piece at "pos", the tail becoming a new node which goes
+           to the right side, ahead of the original right subtree */
+        int cut = pos - leftLen;
+        int headNewlines = countNewlines(node->block->text + node->offset, cut);
+        PieceNode *tail = newNode(table, node->block, node->offset + cut,
+                node->length - cut, node->nNewlines - headNewlines);
+
+        /* the tail must not outrank the ancestors of the node it came from */
+        tail->priority = node->priority;
+        node->length = cut;
+        node->nNewlines = headNewlines;
+        *right = merge(tail, node->right);
+        node->right = NULL;
+        updateNode(node);
+        *left = node;
+    }
+}
+
+/*
+** If the last piece of the tree ends exactly where "block" is filled to,
+** grow it by "length" characters (just appended to the block) and return
+** 1.  This keeps typing from producing a new piece per keystroke.
+*/
+static int extendLast(PieceNode *node, PieceBlock *block, int length,
+	int nNewlines)
+{
+    if (node == NULL)
+        return 0;
+    if (node->right != NULL) {
+        if (!extendLast(node->right, block, length, nNewlines))
+            return 0;
+    } else if (node->block == block &&
+            node->offset + node->length == block->used - length) {
+        node->length += length;
+        node->nNewlines += nNewlines;
+    } else
+        return 0;
+    node->subLength += length;
+    node->subNewlines += nNewlines;
+    return 1;
+}
+
+/*
+** Copy "length" characters of "text" into the table's add blocks, and append
+** pieces referring to them to the tree "tree".  Returns the new tree.
+*/
+static PieceNode *appendText(PieceTable *table, PieceNode *tree,
+	const char *text, int length)
+{
+    PieceBlock *block;
+    int chunk, nNewlines;
+
+    while (length > 0) {
+        block = table->addBlock;
+        if (block == NULL || block->used == PIECE_BLOCK_SIZE) {
+            if (block != NULL)
+                releaseBlock(block);
+            block = table->addBlock = newBlock();
+        }
+        chunk = PIECE_BLOCK_SIZE - block->used;
+        if (chunk > length)
+            chunk = length;
+        memcpy(block->text + block->used, text, chunk);
+        block->used += chunk;
+        nNewlines = countNewlines(text, chunk);
+        if (!extendLast(tree, block, chunk, nNewlines))
+            tree = merge(tree, newNode(table, block, block->used - chunk,
+                    chunk, nNewlines));
+        text += chunk;
+        length -= chunk;
+    }
+    return tree;
+}
+
+/*
+** Find the node holding position "*pos", and convert "*pos" to an offset
+** within that piece
+*/
+static PieceNode *findPiece(PieceNode *node, int *pos)
+{
+    int leftLen;
+
+    while (node != NULL) {
+        leftLen = node->left == NULL ? 0 : node->left->subLength;
+        if (*pos < leftLen) {
+            node = node->left;
+        } else if (*pos < leftLen + node->length) {
+            *pos -= leftLen;
+            return node;
+        } else {
+            *pos -= leftLen + node->length;
+            node = node->right;
+        }
+    }
+    return NULL;
+}
+
+/*
+** Move the text of the piece "node" to the table's add blocks (starting a
+** new one if the current one is read only, so that the copy is writable)
+*/
+static void copyPieceText(PieceTable *table, PieceNode *node)
+{
+    PieceBlock *block = table->addBlock;
+
+    if (block == NULL || readOnly(block) ||
+            PIECE_BLOCK_SIZE - block->used < node->length) {
+        if (block != NULL)
+            releaseBlock(block);
+        block = table->addBlock = newBlock();
+    }
+    memcpy(block->text + block->used, node->block->text + node->offset,
+            node->length);
+    releaseBlock(node->block);
+    node->block = block;
+    block->refCount++;
+    node->offset = block->used;
+    block->used += node->length;
+}
+
+static int readOnly(PieceBlock *block)
+{
+    return block->lent || block->nSnapshotRefs > 0;
+}
+
+static int countPieces(PieceNode *node)
+{
+    if (node == NULL)
+        return 0;
+    return countPieces(node->left) + 1 + countPieces(node->right);
+}
+
+/*
+** Record the pieces of "node" and its subtree in order at "*piece", taking
+** a reference to each one's block, and advance "*piece" past them
+*/
+static void snapshotPieces(PieceNode *node, SnapshotPiece **piece)
+{
+    if (node == NULL)
+        return;
+    snapshotPieces(node->left, piece);
+    (*piece)->block = node->block;
+    (*piece)->offset = node->offset;
+    (*piece)->length = node->length;
+    node->block->refCount++;
+    node->block->nSnapshotRefs++;
+    (*piece)++;
+    snapshotPieces(node->right, piece);
+}
+
+static void copyLentPieces(PieceTable *table, PieceNode *node)
+{
+    if (node == NULL)
+        return;
+    copyLentPieces(table, node->left);
+    if (node->block->lent)
+        copyPieceText(table, node);
+    copyLentPieces(table, node->right);
+}
+
+/*
+** Substitute characters in the pieces of "node" and its subtree.  Pieces of
+** lent or snapshotted text which need changing are first copied, as it
+** mustn't be written.
+*/
+static void substituteInTree(PieceTable *table, PieceNode *node,
+	char fromChar, char toChar)
+{
+    char *text, *c;
+
+    if (node == NULL)
+        return;
+    substituteInTree(table, node->left, fromChar, toChar);
+    text = node->block->text + node->offset;
+    if (readOnly(node->block) &&
+            ScanFindChar(text, node->length, fromChar) != NULL) {
+        copyPieceText(table, node);
+        text = node->block->text + node->offset;
+    }
+    if (!readOnly(node->block))
+        for (c = text; c < text + node->length; c++)
+            if (*c == fromChar)
+                *c = toChar;
+    substituteInTree(table, node->right, fromChar, toChar);
+}
+
+static int countNewlines(const char *text, int length)
+{
+    return ScanCountChar(text, length, '\n');
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+*                                                                              *
+* pieceTable.h -- Nirvana Editor piece table text storage header               *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef NEDIT_PIECETABLE_H_INCLUDED
+#define NEDIT_PIECETABLE_H_INCLUDED
+
+typedef struct _PieceTable PieceTable;
+typedef struct _PieceSnapshot PieceSnapshot;
+
+/* Procedure called once the table no longer refers to any of the text lent
+   to it by PieceTableSetExternal */
+typedef void (*pieceReleaseProc)(void *releaseArg);
+
+/* Procedure which may replace a chunk of lent text with "outLength"
+   characters written to "outText" (there is room for length+1), returning
+   1 if it did, or 0 if the text can be used as it is */
+typedef int (*pieceFilterProc)(const char *text, int length, char *outText,
+        int *outLength, void *filterArg);
+
+/* Procedure receiving the runs of text of a snapshot, returning 0 to stop */
+typedef int (*pieceTextProc)(const char *text, int length, void *cbArg);
+
+PieceTable *PieceTableCreate(void);
+void PieceTableFree(PieceTable *table);
+int PieceTableLength(const PieceTable *table);
+void PieceTableSetAll(PieceTable *table, const char *text, int length);
+void PieceTableSetExternal(PieceTable *table, const char *text, int length,
+        pieceFilterProc filterProc, void *filterArg,
+        pieceReleaseProc releaseProc, void *releaseArg);
+void PieceTableCopyExternal(PieceTable *table);
+void PieceTableInsert(PieceTable *table, int pos, const char *text,
+        int length);
+void PieceTableDelete(PieceTable *table, int start, int end);
+const char *PieceTableSegment(PieceTable *table, int pos, int *segLen);
+const char *PieceTableSegmentBefore(PieceTable *table, int pos, int *segLen);
+char PieceTableGetChar(PieceTable *table, int pos);
+void PieceTableCopyRange(PieceTable *table, int start, int end, char *outStr);
+const char *PieceTableAsString(PieceTable *table);
+void PieceTableSubstituteChar(PieceTable *table, char fromChar, char toChar);
+int PieceTableCountNewlines(PieceTable *table, int pos);
+int PieceTableLineStart(PieceTable *table, int lineNum);
+PieceSnapshot *PieceTableSnapshot(PieceTable *table);
+int PieceSnapshotForEachPiece(const PieceSnapshot *snapshot,
+        pieceTextProc pieceProc, void *cbArg);
+void PieceSnapshotFree(PieceSnapshot *snapshot);
+
+#endif /* NEDIT_PIECETABLE_H_INCLUDED */
@@ -154,6 +154,10 @@ static char *ShowMatchingTypes[] = {"Off", "Delimiter", "Range",
     in nedit.h  */
 static char* TruncSubstitutionModes[] = {"Silent", "Fail", "Warn", "Ignore", NULL};
 
+/*  This array must be kept in parallel to the enum bufStorageTypes
+    in textBuf.h  */
+static char* BufferStorageModes[] = {"GapBuffer", "PieceTable", NULL};
+
 /* suplement wrap and indent styles w/ a value meaning "use default" for
    the override fields in the language modes dialog */
 #define DEFAULT_WRAP -1
@@ -324,6 +328,11 @@ static struct prefData {
     Boolean honorSymlinks;
     int truncSubstitution;
     Boolean forceOSConversion;
+    int bufferStorage;		/* text storage engine for new documents */
+    int mapFileThreshold;	/* size in megabytes at which files are
+    				   mapped into memory instead of read */
+    Boolean syncOnSave;		/* flush saved files to disk before
+    				   reporting success */
 } PrefData;
 
 /* Temporary storage for preferences strings which are discarded after being
@@ -1072,7 +1081,13 @@ static PrefDescripRec PrefDescrip[] = {
     {"truncSubstitution", "TruncSubstitution", PREF_ENUM, "Fail",
             &PrefData.truncSubstitution, TruncSubstitutionModes, False},
     {"honorSymlinks", "HonorSymlinks", PREF_BOOLEAN, "True",
-            &PrefData.honorSymlinks, NULL, False}
+            &PrefData.honorSymlinks, NULL, False},
+    {"bufferStorage", "BufferStorage", PREF_ENUM, "GapBuffer",
+            &PrefData.bufferStorage, BufferStorageModes, False},
+    {"mapFileThreshold", "MapFileThreshold", PREF_INT, "32",
+            &PrefData.mapFileThreshold, NULL, False},
+    {"syncOnSave", "SyncOnSave", PREF_BOOLEAN, "True",
+            &PrefData.syncOnSave, NULL, False}
 };
 
 static XrmOptionDescRec OpTable[] = {
@@ -2177,6 +2192,21 @@ Boolean GetPrefHonorSymlinks(void)
     return PrefData.honorSymlinks;
 }
 
+int GetPrefBufferStorage(void)
+{
+    return PrefData.bufferStorage;
+}
+
+int GetPrefMapFileThreshold(void)
+{
+    return PrefData.mapFileThreshold;
+}
+
+Boolean GetPrefSyncOnSave(void)
+{
+    return PrefData.syncOnSave;
+}
+
 int GetPrefOverrideVirtKeyBindings(void)
 {
     return PrefData.virtKeyOverride;
@@ -3670,12 +3700,12 @@ static languageModeRec *readLMDialogFields(int silent)
                         "Recognition expression:\n%s", "OK", compileMsg);
                 XmProcessTraversal(LMDialog.recogW, XmTRAVERSE_CURRENT);
             }
-            NEditFree(compiledRE);
+            FreeRE(compiledRE);
             freeLanguageModeRec(lm);
             return NULL;    
         }
 
-        NEditFree(compiledRE);
+        FreeRE(compiledRE);
     }
     
     /* Read the default calltips file for the language mode */
@@ -4155,7 +4185,7 @@ static void fillFromPrimaryCB(Widget w, XtPointer clientData,
     primaryName = XmTextGetString(fd->primaryW);
     if (!ExecRE(compiledRE, primaryName, NULL, False, '\0', '\0', NULL, NULL, NULL)) {
     	XBell(XtDisplay(fd->shell), 0);
-    	free(compiledRE);
+    	FreeRE(compiledRE);
     	NEditFree(primaryName);
     	return;
     }
@@ -4171,7 +4201,7 @@ static void fillFromPrimaryCB(Widget w, XtPointer clientData,
     	    MAX_FONT_LEN);
     XmTextSetString(fd->boldItalicW, modifiedFontName);
     NEditFree(primaryName);
-    NEditFree(compiledRE);
+    FreeRE(compiledRE);
 }
 
 static void primaryModifiedCB(Widget w, XtPointer clientData,
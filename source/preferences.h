@@ -209,6 +209,9 @@ Boolean GetPrefUndoModifiesSelection(void);
 Boolean GetPrefFocusOnRaise(void);
 Boolean GetPrefHonorSymlinks(void);
 Boolean GetPrefForceOSConversion(void);
+int GetPrefBufferStorage(void);
+int GetPrefMapFileThreshold(void);
+Boolean GetPrefSyncOnSave(void);
 void SetPrefFocusOnRaise(Boolean);
 
 #endif /* NEDIT_PREFERENCES_H_INCLUDED */
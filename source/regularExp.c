@@ -82,6 +82,7 @@
 #endif
 
 #include "regularExp.h"
+#include "textScan.h"
 #include "../util/nedit_malloc.h"
 
 #include <ctype.h>
@@ -107,9 +108,20 @@
  *
  *   match_start     Character that must begin a match; '\0' if none obvious.
  *   anchor          Is the match anchored (at beginning-of-line only)?
+ *   literal         A string every match must contain, or NULL if none was
+ *                   found.  Points into `program'.
+ *   literal_len     Length of `literal'.
+ *   literal_min     Least number of characters between the beginning of a
+ *   literal_max     match and `literal' (most, or -1 for no limit).
+ *   literal_lead_at Index of the character of `literal' scanned for, one
+ *                   chosen to be rare in typical text.
+ *   literal_lead    The characters that one can be in the text.
+ *   literal_ci      Is `literal' matched case insensitively?
  *
  * `match_start' and `anchor' permit very fast decisions on suitable starting
- * points for a match, considerably reducing the work done by ExecRE. */
+ * points for a match, considerably reducing the work done by ExecRE.  The
+ * `literal' fields let it skip straight to the places where the literal
+ * occurs, and give up at once when it doesn't occur at all. */
 
 /* STRUCTURE FOR A REGULAR EXPRESSION (regex) `PROGRAM'.
  *
@@ -526,6 +538,9 @@ static unsigned char * shortcut_escape (unsigned char c, int *flag_param,
                                         int emit);
 
 static int             init_ansi_classes  (void);
+static void            required_literal (regexp *prog);
+static struct regex_dfa * build_dfa (regexp *prog, unsigned long size);
+static void            free_dfa        (struct regex_dfa *dfa);
 
 /*----------------------------------------------------------------------*
  * CompileRE
@@ -664,9 +679,31 @@ regexp * CompileRE (const char *exp, char **errorText, int defaultFlags) {
       }
    }
 
+   /* Find a literal string that every match must contain. */
+
+   required_literal (comp_regex);
+
+   /* Regexes that are regular get a DFA to speed up forward searches. */
+
+   comp_regex->dfa = build_dfa (comp_regex, Reg_Size);
+
    return (comp_regex);
 }
 
+/*----------------------------------------------------------------------*
+ * FreeRE
+ *
+ * Frees a regex compiled by `CompileRE', along with its DFA.
+ *----------------------------------------------------------------------*/
+
+void FreeRE (regexp *prog) {
+
+   if (prog == NULL) return;
+
+   free_dfa (prog->dfa);
+   NEditFree (prog);
+}
+
 /*----------------------------------------------------------------------*
  * chunk                                                                *
  *                                                                      *
@@ -2607,23 +2644,49 @@ static unsigned char * back_ref (
  *  Regex execution related code
  *======================================================================*/
 
- /* Global work variables for `ExecRE'. */
-
-static unsigned char  *Reg_Input;           /* String-input pointer.         */
-static unsigned char  *Start_Of_String;     /* Beginning of input, for ^     */
-                                            /* and < checks.                 */
-static unsigned char  *End_Of_String;       /* Logical end of input (if
-   				               supplied, till \0 otherwise)  */
-static unsigned char  *Look_Behind_To;      /* Position till were look behind
-                                               can safely check back         */
-static unsigned char **Start_Ptr_Ptr;       /* Pointer to `startp' array.    */
-static unsigned char **End_Ptr_Ptr;         /* Ditto for `endp'.             */
-static unsigned char  *Extent_Ptr_FW;       /* Forward extent pointer        */
-static unsigned char  *Extent_Ptr_BW;       /* Backward extent pointer       */
-static unsigned char  *Back_Ref_Start [10]; /* Back_Ref_Start [0] and        */
-static unsigned char  *Back_Ref_End   [10]; /* Back_Ref_End [0] are not      */
-                                            /* used. This simplifies         */
-                                            /* indexing.                     */
+/* Define a pointer to an array to hold general (...){m,n} counts. */
+
+typedef struct brace_counts {
+    unsigned long count [1]; /* More unwarranted chumminess with compiler. */
+} brace_counts;
+
+/* Work variables for `ExecRE'.  They live in a context rather than in
+   statics so that matches can run in several threads at once. */
+
+struct regex_context {
+   unsigned char  *reg_input;          /* String-input pointer.         */
+   unsigned char  *start_of_string;    /* Beginning of input, for ^     */
+                                       /* and < checks.                 */
+   unsigned char  *end_of_string;      /* Logical end of input (if
+                                          supplied, till \0 otherwise)  */
+   unsigned char  *look_behind_to;     /* Position till were look behind
+                                          can safely check back         */
+   unsigned char **start_ptr_ptr;      /* Pointer to `startp' array.    */
+   unsigned char **end_ptr_ptr;        /* Ditto for `endp'.             */
+   unsigned char  *extent_ptr_fw;      /* Forward extent pointer        */
+   unsigned char  *extent_ptr_bw;      /* Backward extent pointer       */
+   unsigned char  *back_ref_start [10];/* back_ref_start [0] and        */
+   unsigned char  *back_ref_end   [10];/* back_ref_end [0] are not      */
+                                       /* used. This simplifies         */
+                                       /* indexing.                     */
+   int             recursion_count;    /* Recursion counter             */
+   int             recursion_limit_exceeded; /* Recursion limit
+                                                exceeded flag           */
+   int             prev_is_bol;
+   int             succ_is_eol;
+   int             prev_is_delim;
+   int             succ_is_delim;
+   int             total_paren;        /* Parentheses of the regex.     */
+   int             num_braces;         /* Its general {m,n} constructs. */
+   brace_counts   *brace;              /* Counts for those.             */
+   unsigned char  *current_delimiters; /* Current delimiter table       */
+   struct regex_dfa *dfa_filter;       /* DFA telling `attempt' where no
+                                          match can start, or NULL.     */
+   unsigned char  *literal_at;         /* Next occurrence of the regex's
+                                          required literal, or NULL if
+                                          it hasn't been looked for.    */
+};
+
 /*
  * Measured recursion limits:
  *    Linux:      +/-  40 000 (up to 110 000)
@@ -2633,40 +2696,39 @@ static unsigned char  *Back_Ref_End   [10]; /* Back_Ref_End [0] are not      */
  * So 10 000 ought to be safe.
  */
 #define REGEX_RECURSION_LIMIT 10000
-static int Recursion_Count;          /* Recursion counter */
-static int Recursion_Limit_Exceeded; /* Recursion limit exceeded flag */
+
+/* Needs the context of the match, `ctx', in scope. */
 
 #define AT_END_OF_STRING(X) (*(X) == (unsigned char)'\0' ||\
-                             (End_Of_String != NULL && (X) >= End_Of_String))
+                             (ctx->end_of_string != NULL &&\
+                              (X) >= ctx->end_of_string))
 
 /* static regexp *Cross_Regex_Backref; */
 
-static int Prev_Is_BOL;
-static int Succ_Is_EOL;
-static int Prev_Is_Delim;
-static int Succ_Is_Delim;
-
-/* Define a pointer to an array to hold general (...){m,n} counts. */
-
-typedef struct brace_counts {
-    unsigned long count [1]; /* More unwarranted chumminess with compiler. */
-} brace_counts;
-
-static struct brace_counts *Brace;
-
 /* Default table for determining whether a character is a word delimiter. */
 
 static unsigned char  Default_Delimiters [UCHAR_MAX+1] = {0};
 
-static unsigned char *Current_Delimiters;  /* Current delimiter table */
+/* Context used by plain `ExecRE'. */
+
+static regexContext Default_Context;
 
 /* Forward declarations of functions used by `ExecRE' */
 
-static int             attempt            (regexp *, unsigned char *);
-static int             match              (unsigned char *, int *);
-static unsigned long   greedy             (unsigned char *, long);
+static int             attempt            (regexContext *, regexp *,
+                                           unsigned char *);
+static int             match              (regexContext *, unsigned char *,
+                                           int *);
+static unsigned long   greedy             (regexContext *, unsigned char *,
+                                           long);
 static void            adjustcase         (unsigned char *, int, unsigned char);
 static unsigned char * makeDelimiterTable (unsigned char *, unsigned char *);
+static int             dfa_search         (regexContext *, struct regex_dfa *,
+                                           unsigned char *, unsigned char *);
+static int             dfa_matches_at     (regexContext *, struct regex_dfa *,
+                                           unsigned char *);
+static unsigned char * literal_skip       (regexContext *, regexp *,
+                                           unsigned char *);
 
 /*
  * ExecRE - match a `regexp' structure against a string
@@ -2691,14 +2753,58 @@ static unsigned char * makeDelimiterTable (unsigned char *, unsigned char *);
  * past that boundary. If match_to is set to NULL, the terminating \0 is
  * assumed to correspond to the logical boundary. Match_to, if set, must be 
  * larger than or equal to end, if set.
+ *
+ * ExecRE keeps the state of the match in a single static context, so it
+ * must only be called from one thread.  Threads matching concurrently
+ * each call `ExecREWithContext' with a context of their own (and a
+ * compiled regex of their own, since the match is stored in it).
  */
 
 int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
         char prev_char, char succ_char, const char* delimiters,
         const char* look_behind_to, const char* match_to)
 {
+   return (ExecREWithContext (&Default_Context, prog, string, end, reverse,
+                              prev_char, succ_char, delimiters,
+                              look_behind_to, match_to));
+}
+
+/*----------------------------------------------------------------------*
+ * NewREContext, FreeREContext
+ *
+ * Create and destroy a context for `ExecREWithContext'.
+ *----------------------------------------------------------------------*/
+
+regexContext * NewREContext (void) {
+
+   regexContext *ctx;
+
+   ctx = (regexContext *) NEditMalloc (sizeof (regexContext));
+
+   memset (ctx, 0, sizeof (regexContext));
+
+   return (ctx);
+}
+
+void FreeREContext (regexContext *ctx) {
+
+   NEditFree (ctx);
+}
+
+/*----------------------------------------------------------------------*
+ * ExecREWithContext
+ *
+ * `ExecRE' with the state of the match kept in `ctx'.
+ *----------------------------------------------------------------------*/
+
+int ExecREWithContext(regexContext *ctx, regexp *prog, const char* string,
+        const char* end, int reverse, char prev_char, char succ_char,
+        const char* delimiters, const char* look_behind_to,
+        const char* match_to)
+{
 
    register unsigned char  *str;
+            unsigned char  *next;
             unsigned char **s_ptr;
             unsigned char **e_ptr;
                      int    ret_val = 0;
@@ -2707,6 +2813,13 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
 
    /* Check for valid parameters. */
 
+   if (ctx == NULL) {
+      reg_error ("NULL context to `ExecREWithContext\'");
+      return (0);
+   }
+
+   ctx->brace = NULL;
+
    if (prog == NULL || string == NULL) {
       reg_error ("NULL parameter to `ExecRE\'");
       goto SINGLE_RETURN;
@@ -2725,16 +2838,16 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
    /* If caller has supplied delimiters, make a delimiter table */
 
    if (delimiters == NULL) {
-      Current_Delimiters = Default_Delimiters;
+      ctx->current_delimiters = Default_Delimiters;
    } else {
-      Current_Delimiters = makeDelimiterTable (
+      ctx->current_delimiters = makeDelimiterTable (
                               (unsigned char *) delimiters,
                               (unsigned char *) tempDelimitTable);
    }
 
    /* Remember the logical end of the string. */
    
-   End_Of_String = (unsigned char *) match_to;
+   ctx->end_of_string = (unsigned char *) match_to;
    
    if (end == NULL && reverse) {
       for (end = string; !AT_END_OF_STRING((unsigned char*)end); end++) ;
@@ -2749,32 +2862,35 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
 
    /* Remember the beginning of the string for matching BOL */
 
-   Start_Of_String    = (unsigned char *) string;
-   Look_Behind_To     = (unsigned char *) (look_behind_to?look_behind_to:string);
+   ctx->start_of_string = (unsigned char *) string;
+   ctx->look_behind_to  =
+      (unsigned char *) (look_behind_to?look_behind_to:string);
 
-   Prev_Is_BOL        = ((prev_char == '\n') || (prev_char == '\0') ? 1 : 0);
-   Succ_Is_EOL        = ((succ_char == '\n') || (succ_char == '\0') ? 1 : 0);
-   Prev_Is_Delim      = (Current_Delimiters [(unsigned char)prev_char] ? 1 : 0);
-   Succ_Is_Delim      = (Current_Delimiters [(unsigned char)succ_char] ? 1 : 0);
+   ctx->prev_is_bol   = ((prev_char == '\n') || (prev_char == '\0') ? 1 : 0);
+   ctx->succ_is_eol   = ((succ_char == '\n') || (succ_char == '\0') ? 1 : 0);
+   ctx->prev_is_delim =
+      (ctx->current_delimiters [(unsigned char)prev_char] ? 1 : 0);
+   ctx->succ_is_delim =
+      (ctx->current_delimiters [(unsigned char)succ_char] ? 1 : 0);
 
-   Total_Paren        = (int) (prog->program [1]);
-   Num_Braces         = (int) (prog->program [2]);
+   ctx->total_paren   = (int) (prog->program [1]);
+   ctx->num_braces    = (int) (prog->program [2]);
    
    /* Reset the recursion detection flag */
-   Recursion_Limit_Exceeded = 0;
+   ctx->recursion_limit_exceeded = 0;
 
    /* Allocate memory for {m,n} construct counting variables if need be. */
 
-   if (Num_Braces > 0) {
-      Brace =
-         (brace_counts *) NEditMalloc (sizeof (brace_counts) * (size_t) Num_Braces);
+   if (ctx->num_braces > 0) {
+      ctx->brace = (brace_counts *)
+         NEditMalloc (sizeof (brace_counts) * (size_t) ctx->num_braces);
 
-      if (Brace == NULL) {
+      if (ctx->brace == NULL) {
          reg_error ("out of memory in `ExecRE\'");
          goto SINGLE_RETURN;
       }
    } else {
-      Brace = NULL;
+      ctx->brace = NULL;
    }
 
    /* Initialize the first nine (9) capturing parentheses start and end
@@ -2788,21 +2904,38 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
       *e_ptr++ = (unsigned char *) string;
    }
 
+   ctx->dfa_filter = NULL;
+   ctx->literal_at = NULL;
+
    if (!reverse) { /* Forward Search */
       if (prog->anchor) {
          /* Search is anchored at BOL */
 
-         if (attempt (prog, (unsigned char *) string)) {
+         if (attempt (ctx, prog, (unsigned char *) string)) {
             ret_val = 1;
             goto SINGLE_RETURN;
          }
 
          for (str = (unsigned char *) string;
-             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !Recursion_Limit_Exceeded;
+             !AT_END_OF_STRING(str) && str != (unsigned char *) end &&
+             !ctx->recursion_limit_exceeded;
               str++) {
 
+            /* Go straight to the first line a match could start on as far
+               as the required literal is concerned. */
+
+            if (prog->literal != NULL &&
+                (next = literal_skip (ctx, prog, str + 1)) != str + 1) {
+
+               if (next == NULL ||
+                   (end != NULL && next > (unsigned char *) end)) break;
+
+               str = next - 2;
+               continue;
+            }
+
             if (*str == '\n') {
-               if (attempt (prog, str + 1)) {
+               if (attempt (ctx, prog, str + 1)) {
                   ret_val = 1;
                   break;
                }
@@ -2815,11 +2948,22 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
          /* We know what char match must start with. */
 
          for (str = (unsigned char *) string;
-             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !Recursion_Limit_Exceeded;
+             !AT_END_OF_STRING(str) && str != (unsigned char *) end &&
+             !ctx->recursion_limit_exceeded;
               str++) {
 
+            if (prog->literal != NULL &&
+                (next = literal_skip (ctx, prog, str)) != str) {
+
+               if (next == NULL ||
+                   (end != NULL && next > (unsigned char *) end)) break;
+
+               str = next - 1;
+               continue;
+            }
+
             if (*str == (unsigned char)prog->match_start) {
-               if (attempt (prog, str)) {
+               if (attempt (ctx, prog, str)) {
                   ret_val = 1;
                   break;
                }
@@ -2830,19 +2974,53 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
       } else {
          /* General case */
 
+         /* When the regex has a required literal or a DFA, first make sure
+            there is a match at all, then skip the places where none can
+            start.  A literal at a bounded distance from the start of the
+            match already does the skipping better than the DFA. */
+
+         if (prog->literal != NULL &&
+             literal_skip (ctx, prog, (unsigned char *) string) == NULL) {
+            goto SINGLE_RETURN;
+         }
+
+         if (prog->dfa != NULL &&
+             (prog->literal == NULL || prog->literal_max < 0)) {
+            switch (dfa_search (ctx, prog->dfa, (unsigned char *) string,
+                                (unsigned char *) end)) {
+               case 0:
+                  goto SINGLE_RETURN;
+
+               case 1:
+                  ctx->dfa_filter = prog->dfa;
+            }
+         }
+
          for (str = (unsigned char *) string;
-             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !Recursion_Limit_Exceeded;
+             !AT_END_OF_STRING(str) && str != (unsigned char *) end &&
+             !ctx->recursion_limit_exceeded;
               str++) {
 
-            if (attempt (prog, str)) {
+            if (prog->literal != NULL &&
+                (next = literal_skip (ctx, prog, str)) != str) {
+
+               if (next == NULL ||
+                   (end != NULL && next > (unsigned char *) end)) break;
+
+               str = next - 1;
+               continue;
+            }
+
+            if (attempt (ctx, prog, str)) {
                ret_val = 1;
                break;
             }
          }
          
          /* Beware of a single $ matching \0 */
-         if (!Recursion_Limit_Exceeded && !ret_val && AT_END_OF_STRING(str) && str != (unsigned char *) end) {
-            if (attempt (prog, str)) {
+         if (!ctx->recursion_limit_exceeded && !ret_val &&
+             AT_END_OF_STRING(str) && str != (unsigned char *) end) {
+            if (attempt (ctx, prog, str)) {
                ret_val = 1;
             }
          }
@@ -2852,26 +3030,28 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
    } else { /* Search reverse, same as forward, but loops run backward */
       
       /* Make sure that we don't start matching beyond the logical end */
-      if (End_Of_String != NULL && (unsigned char*)end > End_Of_String) {
-         end = (const char*)End_Of_String;
+      if (ctx->end_of_string != NULL &&
+          (unsigned char*)end > ctx->end_of_string) {
+         end = (const char*)ctx->end_of_string;
       }
 
       if (prog->anchor) {
          /* Search is anchored at BOL */
 
          for (str = (unsigned char *)(end - 1);
-              str >= (unsigned char *) string && !Recursion_Limit_Exceeded;
+              str >= (unsigned char *) string && !ctx->recursion_limit_exceeded;
               str--) {
 
             if (*str == '\n') {
-               if (attempt (prog, str + 1)) {
+               if (attempt (ctx, prog, str + 1)) {
                   ret_val = 1;
                   goto SINGLE_RETURN;
                }
             }
          }
 
-         if (!Recursion_Limit_Exceeded && attempt (prog, (unsigned char *) string)) {
+         if (!ctx->recursion_limit_exceeded &&
+             attempt (ctx, prog, (unsigned char *) string)) {
             ret_val = 1;
             goto SINGLE_RETURN;
          }
@@ -2881,11 +3061,11 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
          /* We know what char match must start with. */
 
          for (str =  (unsigned char *) end;
-              str >= (unsigned char *) string && !Recursion_Limit_Exceeded;
+              str >= (unsigned char *) string && !ctx->recursion_limit_exceeded;
               str--) {
 
             if (*str == (unsigned char)prog->match_start) {
-               if (attempt (prog, str)) {
+               if (attempt (ctx, prog, str)) {
                   ret_val = 1;
                   break;
                }
@@ -2897,10 +3077,10 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
          /* General case */
 
          for (str =  (unsigned char *) end;
-              str >= (unsigned char *) string && !Recursion_Limit_Exceeded;
+              str >= (unsigned char *) string && !ctx->recursion_limit_exceeded;
               str--) {
 
-            if (attempt (prog, str)) {
+            if (attempt (ctx, prog, str)) {
                ret_val = 1;
                break;
             }
@@ -2908,9 +3088,9 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
       }
    }
 
-   SINGLE_RETURN: if (Brace) free (Brace);
+   SINGLE_RETURN: if (ctx->brace) free (ctx->brace);
 
-   if (Recursion_Limit_Exceeded) return (0);
+   if (ctx->recursion_limit_exceeded) return (0);
 
    return (ret_val);
 }
@@ -2975,38 +3155,56 @@ static int init_ansi_classes (void) {
  * attempt - try match at specific point, returns: 0 failure, 1 success
  *----------------------------------------------------------------------*/
 
-static int attempt (regexp *prog, unsigned char *string) {
+static int attempt (
+   regexContext  *ctx,
+   regexp        *prog,
+   unsigned char *string) {
 
    register          int    i;
    register unsigned char **s_ptr;
    register unsigned char **e_ptr;
    		     int    branch_index = 0; /* Must be set to zero ! */
 
-   Reg_Input      = string;
-   Start_Ptr_Ptr  = (unsigned char **) prog->startp;
-   End_Ptr_Ptr    = (unsigned char **) prog->endp;
+   /* Skip the places where the DFA knows no match can start. */
+
+   if (ctx->dfa_filter != NULL) {
+      switch (dfa_matches_at (ctx, ctx->dfa_filter, string)) {
+         case 0:
+            return (0);
+
+         case 1:
+            break;
+
+         default: /* The DFA gave up. */
+            ctx->dfa_filter = NULL;
+      }
+   }
+
+   ctx->reg_input      = string;
+   ctx->start_ptr_ptr  = (unsigned char **) prog->startp;
+   ctx->end_ptr_ptr    = (unsigned char **) prog->endp;
    s_ptr          = (unsigned char **) prog->startp;
    e_ptr          = (unsigned char **) prog->endp;
 
    /* Reset the recursion counter. */
-   Recursion_Count = 0;
+   ctx->recursion_count = 0;
 
    /* Overhead due to capturing parentheses. */
 
-   Extent_Ptr_BW = string;
-   Extent_Ptr_FW = NULL;
+   ctx->extent_ptr_bw = string;
+   ctx->extent_ptr_fw = NULL;
 
-   for (i = Total_Paren + 1; i > 0; i--) {
+   for (i = ctx->total_paren + 1; i > 0; i--) {
       *s_ptr++ = NULL;
       *e_ptr++ = NULL;
    }
 
-   if (match ((unsigned char *) (prog->program + REGEX_START_OFFSET),
+   if (match (ctx, (unsigned char *) (prog->program + REGEX_START_OFFSET),
 	&branch_index)) {
       prog->startp [0] = (char *) string;
-      prog->endp   [0] = (char *) Reg_Input;     /* <-- One char AFTER  */
-      prog->extentpBW  = (char *) Extent_Ptr_BW; /*     matched string! */
-      prog->extentpFW  = (char *) Extent_Ptr_FW;
+      prog->endp   [0] = (char *) ctx->reg_input;     /* <-- One char AFTER  */
+      prog->extentpBW  = (char *) ctx->extent_ptr_bw; /*     matched string! */
+      prog->extentpFW  = (char *) ctx->extent_ptr_fw;
       prog->top_branch = branch_index;
 
       return (1);
@@ -3026,20 +3224,23 @@ static int attempt (regexp *prog, unsigned char *string) {
  * loop instead of by recursion.  Returns 0 failure, 1 success.
  *----------------------------------------------------------------------*/
 #define MATCH_RETURN(X)\
- { --Recursion_Count; return (X); }
+ { --ctx->recursion_count; return (X); }
 #define CHECK_RECURSION_LIMIT\
- if (Recursion_Limit_Exceeded) MATCH_RETURN (0);
+ if (ctx->recursion_limit_exceeded) MATCH_RETURN (0);
  
-static int match (unsigned char *prog, int *branch_index_param) {
+static int match (
+   regexContext  *ctx,
+   unsigned char *prog,
+   int           *branch_index_param) {
 
    register unsigned char *scan;  /* Current node. */
             unsigned char *next;  /* Next node. */
    register int next_ptr_offset;  /* Used by the NEXT_PTR () macro */
    
-   if (++Recursion_Count > REGEX_RECURSION_LIMIT) {
-       if (!Recursion_Limit_Exceeded) /* Prevent duplicate errors */
+   if (++ctx->recursion_count > REGEX_RECURSION_LIMIT) {
+       if (!ctx->recursion_limit_exceeded) /* Prevent duplicate errors */
            reg_error("recursion limit exceeded, please respecify expression");
-       Recursion_Limit_Exceeded = 1;
+       ctx->recursion_limit_exceeded = 1;
        MATCH_RETURN (0);
    }
 	    
@@ -3059,9 +3260,9 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   next = OPERAND (scan);   /* Avoid recursion. */
                } else {
                   do {
-                     save = Reg_Input;
+                     save = ctx->reg_input;
 
-                     if (match (OPERAND (scan), NULL)) 
+                     if (match (ctx, OPERAND (scan), NULL)) 
 		     {
 			if (branch_index_param)
 			   *branch_index_param = branch_index_local;
@@ -3072,7 +3273,7 @@ static int match (unsigned char *prog, int *branch_index_param) {
 
 		     ++branch_index_local;
 
-                     Reg_Input = save; /* Backtrack. */
+                     ctx->reg_input = save; /* Backtrack. */
                      NEXT_PTR (scan, scan);
                   } while (scan != NULL && GET_OP_CODE (scan) == BRANCH);
 
@@ -3091,21 +3292,22 @@ static int match (unsigned char *prog, int *branch_index_param) {
 
                /* Inline the first character, for speed. */
 
-               if (*opnd != *Reg_Input) MATCH_RETURN (0);
+               if (*opnd != *ctx->reg_input) MATCH_RETURN (0);
 
                len = strlen ((char *) opnd);
                
-               if (End_Of_String != NULL && Reg_Input + len > End_Of_String) {
+               if (ctx->end_of_string != NULL &&
+                   ctx->reg_input + len > ctx->end_of_string) {
                    MATCH_RETURN (0);
                }
 
                if (len > 1  &&
-                   strncmp ((char *) opnd, (char *) Reg_Input, len) != 0) {
+                   strncmp ((char *) opnd, (char *) ctx->reg_input, len) != 0) {
 
                    MATCH_RETURN (0);
                }
 
-               Reg_Input += len;
+               ctx->reg_input += len;
             }
 
             break;
@@ -3121,8 +3323,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   regex compile. */
 
                while ((test = *opnd++) != '\0') {
-                  if (AT_END_OF_STRING(Reg_Input) ||
-                      tolower (*Reg_Input++) != test) {
+                  if (AT_END_OF_STRING(ctx->reg_input) ||
+                      tolower (*ctx->reg_input++) != test) {
                      
                       MATCH_RETURN (0);
                   }
@@ -3132,16 +3334,16 @@ static int match (unsigned char *prog, int *branch_index_param) {
             break;
 
          case BOL: /* `^' (beginning of line anchor) */
-            if (Reg_Input == Start_Of_String) {
-               if (Prev_Is_BOL) break;
-            } else if (*(Reg_Input - 1) == '\n') {
+            if (ctx->reg_input == ctx->start_of_string) {
+               if (ctx->prev_is_bol) break;
+            } else if (*(ctx->reg_input - 1) == '\n') {
                break;
             }
 
             MATCH_RETURN (0);
 
          case EOL: /* `$' anchor matches end of line and end of string */
-            if (*Reg_Input == '\n' || (AT_END_OF_STRING(Reg_Input) && Succ_Is_EOL)) {
+            if (*ctx->reg_input == '\n' || (AT_END_OF_STRING(ctx->reg_input) && ctx->succ_is_eol)) {
                break;
             }
 
@@ -3152,17 +3354,17 @@ static int match (unsigned char *prog, int *branch_index_param) {
                and the preceding character is. */
             {
 	       int prev_is_delim;
-	       if (Reg_Input == Start_Of_String) {
-		   prev_is_delim = Prev_Is_Delim;
+	       if (ctx->reg_input == ctx->start_of_string) {
+		   prev_is_delim = ctx->prev_is_delim;
 	       } else {
-		   prev_is_delim = Current_Delimiters [ *(Reg_Input - 1) ];
+		   prev_is_delim = ctx->current_delimiters [ *(ctx->reg_input - 1) ];
 	       }
 	       if (prev_is_delim) {
 		   int current_is_delim;
-		   if (AT_END_OF_STRING(Reg_Input)) {
-		      current_is_delim = Succ_Is_Delim;
+		   if (AT_END_OF_STRING(ctx->reg_input)) {
+		      current_is_delim = ctx->succ_is_delim;
 		   } else {
-		      current_is_delim = Current_Delimiters [ *Reg_Input ];
+		      current_is_delim = ctx->current_delimiters [ *ctx->reg_input ];
 		   }
 		   if (!current_is_delim) break;
 	       }
@@ -3175,17 +3377,17 @@ static int match (unsigned char *prog, int *branch_index_param) {
 	       and the preceding character is not. */
             {
 	       int prev_is_delim;
-	       if (Reg_Input == Start_Of_String) {
-		   prev_is_delim = Prev_Is_Delim;
+	       if (ctx->reg_input == ctx->start_of_string) {
+		   prev_is_delim = ctx->prev_is_delim;
 	       } else {
-		   prev_is_delim = Current_Delimiters [ *(Reg_Input-1) ];
+		   prev_is_delim = ctx->current_delimiters [ *(ctx->reg_input-1) ];
 	       }
 	       if (!prev_is_delim) {
 		   int current_is_delim;
-		   if (AT_END_OF_STRING(Reg_Input)) {
-		      current_is_delim = Succ_Is_Delim;
+		   if (AT_END_OF_STRING(ctx->reg_input)) {
+		      current_is_delim = ctx->succ_is_delim;
 		   } else {
-		      current_is_delim = Current_Delimiters [ *Reg_Input ];
+		      current_is_delim = ctx->current_delimiters [ *ctx->reg_input ];
 		   }
 		   if (current_is_delim) break;
 	       }
@@ -3197,15 +3399,15 @@ static int match (unsigned char *prog, int *branch_index_param) {
             {
 	       int prev_is_delim;
 	       int current_is_delim;
-	       if (Reg_Input == Start_Of_String) {
-		   prev_is_delim = Prev_Is_Delim;
+	       if (ctx->reg_input == ctx->start_of_string) {
+		   prev_is_delim = ctx->prev_is_delim;
 	       } else {
-		   prev_is_delim = Current_Delimiters [ *(Reg_Input-1) ]; 
+		   prev_is_delim = ctx->current_delimiters [ *(ctx->reg_input-1) ]; 
 	       }
-	       if (AT_END_OF_STRING(Reg_Input)) {
-		  current_is_delim = Succ_Is_Delim;
+	       if (AT_END_OF_STRING(ctx->reg_input)) {
+		  current_is_delim = ctx->succ_is_delim;
 	       } else {
-		  current_is_delim = Current_Delimiters [ *Reg_Input ];
+		  current_is_delim = ctx->current_delimiters [ *ctx->reg_input ];
 	       }
 	       if (!(prev_is_delim ^ current_is_delim)) break;
 	    }
@@ -3213,121 +3415,121 @@ static int match (unsigned char *prog, int *branch_index_param) {
             MATCH_RETURN (0);
 
          case IS_DELIM: /* \y (A word delimiter character.) */
-            if (Current_Delimiters [ *Reg_Input ] && 
-                !AT_END_OF_STRING(Reg_Input)) {
-               Reg_Input++; break;
+            if (ctx->current_delimiters [ *ctx->reg_input ] && 
+                !AT_END_OF_STRING(ctx->reg_input)) {
+               ctx->reg_input++; break;
             }
 
             MATCH_RETURN (0);
 
          case NOT_DELIM: /* \Y (NOT a word delimiter character.) */
-            if (!Current_Delimiters [ *Reg_Input ] && 
-                !AT_END_OF_STRING(Reg_Input)) {
-               Reg_Input++; break;
+            if (!ctx->current_delimiters [ *ctx->reg_input ] && 
+                !AT_END_OF_STRING(ctx->reg_input)) {
+               ctx->reg_input++; break;
             }
 
             MATCH_RETURN (0);
 
          case WORD_CHAR: /* \w (word character; alpha-numeric or underscore) */
-            if ((isalnum ((int) *Reg_Input) || *Reg_Input == '_') && 
-                !AT_END_OF_STRING(Reg_Input)) {
-               Reg_Input++; break;
+            if ((isalnum ((int) *ctx->reg_input) || *ctx->reg_input == '_') && 
+                !AT_END_OF_STRING(ctx->reg_input)) {
+               ctx->reg_input++; break;
             }
 
             MATCH_RETURN (0);
 
          case NOT_WORD_CHAR:/* \W (NOT a word character) */
-            if (isalnum ((int) *Reg_Input) ||
-                *Reg_Input == '_'          ||
-                *Reg_Input == '\n'         ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isalnum ((int) *ctx->reg_input) ||
+                *ctx->reg_input == '_'          ||
+                *ctx->reg_input == '\n'         ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case ANY: /* `.' (matches any character EXCEPT newline) */
-            if (AT_END_OF_STRING(Reg_Input) || *Reg_Input == '\n') MATCH_RETURN (0);
+            if (AT_END_OF_STRING(ctx->reg_input) || *ctx->reg_input == '\n') MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case EVERY: /* `.' (matches any character INCLUDING newline) */
-            if (AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case DIGIT: /* \d, same as [0123456789] */
-            if (!isdigit ((int) *Reg_Input) ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isdigit ((int) *ctx->reg_input) ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case NOT_DIGIT: /* \D, same as [^0123456789] */
-            if (isdigit ((int) *Reg_Input) || 
-                *Reg_Input == '\n'         ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isdigit ((int) *ctx->reg_input) || 
+                *ctx->reg_input == '\n'         ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case LETTER: /* \l, same as [a-zA-Z] */
-            if (!isalpha ((int) *Reg_Input) ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isalpha ((int) *ctx->reg_input) ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case NOT_LETTER: /* \L, same as [^0123456789] */
-            if (isalpha ((int) *Reg_Input)  || 
-                *Reg_Input == '\n' ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isalpha ((int) *ctx->reg_input)  || 
+                *ctx->reg_input == '\n' ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case SPACE: /* \s, same as [ \t\r\f\v] */
-            if (!isspace ((int) *Reg_Input) || 
-                *Reg_Input == '\n'          ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isspace ((int) *ctx->reg_input) || 
+                *ctx->reg_input == '\n'          ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case SPACE_NL: /* \s, same as [\n \t\r\f\v] */
-            if (!isspace ((int) *Reg_Input) ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isspace ((int) *ctx->reg_input) ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case NOT_SPACE: /* \S, same as [^\n \t\r\f\v] */
-            if (isspace ((int) *Reg_Input) || 
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isspace ((int) *ctx->reg_input) || 
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case NOT_SPACE_NL: /* \S, same as [^ \t\r\f\v] */
-            if ((isspace ((int) *Reg_Input) && *Reg_Input != '\n') ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if ((isspace ((int) *ctx->reg_input) && *ctx->reg_input != '\n') ||
+                AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case ANY_OF:  /* [...] character class. */
-            if (AT_END_OF_STRING(Reg_Input)) 
+            if (AT_END_OF_STRING(ctx->reg_input)) 
                MATCH_RETURN (0); /* Needed because strchr ()
                                     considers \0 as a member
                                     of the character set. */
 
-            if (strchr ((char *) OPERAND (scan), (int) *Reg_Input) == NULL) {
+            if (strchr ((char *) OPERAND (scan), (int) *ctx->reg_input) == NULL) {
                MATCH_RETURN (0);
             }
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case ANY_BUT: /* [^...] Negated character class-- does NOT normally
                        match newline (\n added usually to operand at compile
                        time.) */
 
-            if (AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0); /* See comment for ANY_OF. */
+            if (AT_END_OF_STRING(ctx->reg_input)) MATCH_RETURN (0); /* See comment for ANY_OF. */
 
-            if (strchr ((char *) OPERAND (scan), (int) *Reg_Input) != NULL) {
+            if (strchr ((char *) OPERAND (scan), (int) *ctx->reg_input) != NULL) {
                MATCH_RETURN (0);
             }
 
-            Reg_Input++; break;
+            ctx->reg_input++; break;
 
          case NOTHING:
          case BACK:
@@ -3397,17 +3599,17 @@ static int match (unsigned char *prog, int *branch_index_param) {
                      next_op = OPERAND (scan + (2 * NEXT_PTR_SIZE));
                }
 
-               save = Reg_Input;
+               save = ctx->reg_input;
 
                if (lazy) {
-                  if ( min > REG_ZERO) num_matched = greedy (next_op, min);
+                  if ( min > REG_ZERO) num_matched = greedy (ctx, next_op, min);
                } else {
-                  num_matched = greedy (next_op, max);
+                  num_matched = greedy (ctx, next_op, max);
                }
 
                while (min <= num_matched && num_matched <= max) {
-                  if (next_char == '\0' || next_char == *Reg_Input) {
-                     if (match (next, NULL)) MATCH_RETURN (1);
+                  if (next_char == '\0' || next_char == *ctx->reg_input) {
+                     if (match (ctx, next, NULL)) MATCH_RETURN (1);
                      
                      CHECK_RECURSION_LIMIT
                   }
@@ -3415,7 +3617,11 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   /* Couldn't or didn't match. */
 
                   if (lazy) {
-                     if (!greedy (next_op, 1)) MATCH_RETURN (0);
+                     /* The failed match above may have moved `reg_input'. */
+
+                     ctx->reg_input = save + num_matched;
+
+                     if (!greedy (ctx, next_op, 1)) MATCH_RETURN (0);
 
                      num_matched++; /* Inch forward. */
                   } else if (num_matched > REG_ZERO) {
@@ -3424,7 +3630,7 @@ static int match (unsigned char *prog, int *branch_index_param) {
                      break;
                   }
 
-                  Reg_Input = save + num_matched;
+                  ctx->reg_input = save + num_matched;
                }
 
                MATCH_RETURN (0);
@@ -3433,8 +3639,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
             break;
 
          case END:
-            if (Extent_Ptr_FW == NULL || (Reg_Input - Extent_Ptr_FW) > 0) {
-               Extent_Ptr_FW = Reg_Input;
+            if (ctx->extent_ptr_fw == NULL || (ctx->reg_input - ctx->extent_ptr_fw) > 0) {
+               ctx->extent_ptr_fw = ctx->reg_input;
             }
 
             MATCH_RETURN (1);  /* Success! */
@@ -3442,17 +3648,17 @@ static int match (unsigned char *prog, int *branch_index_param) {
             break;
 
          case INIT_COUNT:
-            Brace->count [*OPERAND (scan)] = REG_ZERO;
+            ctx->brace->count [*OPERAND (scan)] = REG_ZERO;
 
             break;
 
          case INC_COUNT:
-            Brace->count [*OPERAND (scan)]++;
+            ctx->brace->count [*OPERAND (scan)]++;
 
             break;
 
          case TEST_COUNT:
-            if (Brace->count [*OPERAND (scan)] <
+            if (ctx->brace->count [*OPERAND (scan)] <
                (unsigned long) GET_OFFSET (scan + NEXT_PTR_SIZE + INDEX_SIZE)) {
 
                next = scan + NODE_SIZE + INDEX_SIZE + NEXT_PTR_SIZE;
@@ -3481,8 +3687,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   finish =
                      (unsigned char *) Cross_Regex_Backref->endp   [paren_no];
                } else { */
-                  captured = Back_Ref_Start [paren_no];
-                  finish   = Back_Ref_End   [paren_no];
+                  captured = ctx->back_ref_start [paren_no];
+                  finish   = ctx->back_ref_end   [paren_no];
                /* } */
 
                if ((captured != NULL) && (finish != NULL)) {
@@ -3492,15 +3698,15 @@ static int match (unsigned char *prog, int *branch_index_param) {
                       GET_OP_CODE (scan) == X_REGEX_BR_CI*/ ) {
 
                      while (captured < finish) {
-                        if (AT_END_OF_STRING(Reg_Input) ||
-                            tolower (*captured++) != tolower (*Reg_Input++)) {
+                        if (AT_END_OF_STRING(ctx->reg_input) ||
+                            tolower (*captured++) != tolower (*ctx->reg_input++)) {
                            MATCH_RETURN (0);
                         }
                      }
                   } else {
                      while (captured < finish) {
-                        if (AT_END_OF_STRING(Reg_Input) ||
-                            *captured++ != *Reg_Input++) MATCH_RETURN (0);
+                        if (AT_END_OF_STRING(ctx->reg_input) ||
+                            *captured++ != *ctx->reg_input++) MATCH_RETURN (0);
                      }
                   }
 
@@ -3517,14 +3723,14 @@ static int match (unsigned char *prog, int *branch_index_param) {
                register unsigned char *saved_end;
                                  int   answer;
 
-               save      = Reg_Input;
+               save      = ctx->reg_input;
                
                /* Temporarily ignore the logical end of the string, to allow
                   lookahead past the end. */
-               saved_end = End_Of_String;
-               End_Of_String = NULL;
+               saved_end = ctx->end_of_string;
+               ctx->end_of_string = NULL;
                
-               answer    = match (next, NULL); /* Does the look-ahead regex match? */
+               answer    = match (ctx, next, NULL); /* Does the look-ahead regex match? */
 
                CHECK_RECURSION_LIMIT
 
@@ -3537,12 +3743,12 @@ static int match (unsigned char *prog, int *branch_index_param) {
                      may need more text than it matches to accomplish a
                      re-match. */
 
-                  if (Extent_Ptr_FW == NULL || (Reg_Input - Extent_Ptr_FW) > 0) {
-                     Extent_Ptr_FW = Reg_Input;
+                  if (ctx->extent_ptr_fw == NULL || (ctx->reg_input - ctx->extent_ptr_fw) > 0) {
+                     ctx->extent_ptr_fw = ctx->reg_input;
                   }
 
-                  Reg_Input = save; /* Backtrack to look-ahead start. */
-                  End_Of_String = saved_end; /* Restore logical end. */
+                  ctx->reg_input = save; /* Backtrack to look-ahead start. */
+                  ctx->end_of_string = saved_end; /* Restore logical end. */
 
                   /* Jump to the node just after the (?=...) or (?!...)
                      Construct. */
@@ -3553,8 +3759,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
 		      next = next_ptr (next);
                   next = next_ptr (next); /* Skip the LOOK_AHEAD_CLOSE */
                } else {
-                  Reg_Input = save; /* Backtrack to look-ahead start. */
-                  End_Of_String = saved_end; /* Restore logical end. */
+                  ctx->reg_input = save; /* Backtrack to look-ahead start. */
+                  ctx->end_of_string = saved_end; /* Restore logical end. */
 
                   MATCH_RETURN (0);
                }
@@ -3572,13 +3778,13 @@ static int match (unsigned char *prog, int *branch_index_param) {
                                  int   found = 0;
                         unsigned char *saved_end;
 
-               save      = Reg_Input;
-               saved_end = End_Of_String;
+               save      = ctx->reg_input;
+               saved_end = ctx->end_of_string;
                
                /* Prevent overshoot (greedy matching could end past the
                   current position) by tightening the matching boundary. 
                   Lookahead inside lookbehind can still cross that boundary. */
-               End_Of_String = Reg_Input;
+               ctx->end_of_string = ctx->reg_input;
                
                lower = GET_LOWER (scan);
                upper = GET_UPPER (scan);
@@ -3589,20 +3795,20 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   is not constant: we have to make sure the expression doesn't
                   match for _any_ of the starting positions. */
                for (offset = lower; offset <= upper; ++offset) {
-	          Reg_Input = save - offset;
+	          ctx->reg_input = save - offset;
 	          
-                  if (Reg_Input < Look_Behind_To) {
+                  if (ctx->reg_input < ctx->look_behind_to) {
                      /* No need to look any further */
                      break;
            	  }
                   
-                  answer    = match (next, NULL); /* Does the look-behind regex match? */
+                  answer    = match (ctx, next, NULL); /* Does the look-behind regex match? */
 
                   CHECK_RECURSION_LIMIT
 
                   /* The match must have ended at the current position;
                      otherwise it is invalid */
-                  if (answer && Reg_Input == save) {
+                  if (answer && ctx->reg_input == save) {
                      /* It matched, exactly far enough */
                      found = 1;
                      
@@ -3614,9 +3820,9 @@ static int match (unsigned char *prog, int *branch_index_param) {
                         leading look-behind may need more text than it matches
                         to accomplish a re-match. */
 
-                     if (Extent_Ptr_BW == NULL || 
-                         (Extent_Ptr_BW - (save - offset)) > 0) {
-                        Extent_Ptr_BW = save - offset;
+                     if (ctx->extent_ptr_bw == NULL || 
+                         (ctx->extent_ptr_bw - (save - offset)) > 0) {
+                        ctx->extent_ptr_bw = save - offset;
                      }
 
                      break;
@@ -3624,8 +3830,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
                }
                
 	       /* Always restore the position and the logical string end. */
-	       Reg_Input = save;
-               End_Of_String = saved_end;
+	       ctx->reg_input = save;
+               ctx->end_of_string = saved_end;
                
                if ((GET_OP_CODE (scan) == POS_BEHIND_OPEN) ? found : !found) {
                   /* The look-behind matches, so we must jump to the next
@@ -3657,18 +3863,18 @@ static int match (unsigned char *prog, int *branch_index_param) {
                register unsigned char *save;
 
                no   = GET_OP_CODE (scan) - OPEN;
-               save = Reg_Input;
+               save = ctx->reg_input;
 
                if (no < 10) {
-                  Back_Ref_Start [no] = save;
-                  Back_Ref_End   [no] = NULL;
+                  ctx->back_ref_start [no] = save;
+                  ctx->back_ref_end   [no] = NULL;
                }
 
-               if (match (next, NULL)) {
-                  /* Do not set `Start_Ptr_Ptr' if some later invocation (think
+               if (match (ctx, next, NULL)) {
+                  /* Do not set `start_ptr_ptr' if some later invocation (think
                      recursion) of the same parentheses already has. */
 
-                  if (Start_Ptr_Ptr [no] == NULL) Start_Ptr_Ptr [no] = save;
+                  if (ctx->start_ptr_ptr [no] == NULL) ctx->start_ptr_ptr [no] = save;
 
                   MATCH_RETURN (1);
                } else {
@@ -3681,15 +3887,15 @@ static int match (unsigned char *prog, int *branch_index_param) {
                register unsigned char *save;
 
                no   = GET_OP_CODE (scan) - CLOSE;
-               save = Reg_Input;
+               save = ctx->reg_input;
 
-               if (no < 10) Back_Ref_End [no] = save;
+               if (no < 10) ctx->back_ref_end [no] = save;
 
-               if (match (next, NULL)) {
+               if (match (ctx, next, NULL)) {
                   /* Do not set `End_Ptr_Ptr' if some later invocation of the
                      same parentheses already has. */
 
-                  if (End_Ptr_Ptr [no] == NULL) End_Ptr_Ptr [no] = save;
+                  if (ctx->end_ptr_ptr [no] == NULL) ctx->end_ptr_ptr [no] = save;
 
                   MATCH_RETURN (1);
                } else {
@@ -3729,14 +3935,14 @@ static int match (unsigned char *prog, int *branch_index_param) {
  * Returns the actual number of matches.
  *----------------------------------------------------------------------*/
 
-static unsigned long greedy (unsigned char *p, long max) {
+static unsigned long greedy (regexContext *ctx, unsigned char *p, long max) {
 
    register unsigned char *input_str;
    register unsigned char *operand;
    register unsigned long  count = REG_ZERO;
    register unsigned long  max_cmp;
 
-   input_str = Reg_Input;
+   input_str = ctx->reg_input;
    operand   = OPERAND (p); /* Literal char or start of class characters. */
    max_cmp   = (max > 0) ? (unsigned long) max : ULONG_MAX;
 
@@ -3808,7 +4014,7 @@ static unsigned long greedy (unsigned char *p, long max) {
                          NOTE: '\n' and '\0' are always word delimiters. */
 
          while (count < max_cmp                   && 
-                Current_Delimiters [ *input_str ] &&
+                ctx->current_delimiters [ *input_str ] &&
                 !AT_END_OF_STRING(input_str)) {
             count++; input_str++;
          }
@@ -3819,7 +4025,7 @@ static unsigned long greedy (unsigned char *p, long max) {
                          NOTE: '\n' and '\0' are always word delimiters. */
 
          while (count < max_cmp                    && 
-                !Current_Delimiters [ *input_str ] &&
+                !ctx->current_delimiters [ *input_str ] &&
                 !AT_END_OF_STRING(input_str)) {
             count++; input_str++;
          }
@@ -3942,7 +4148,7 @@ static unsigned long greedy (unsigned char *p, long max) {
 
    /* Point to character just after last matched character. */
 
-   Reg_Input = input_str;
+   ctx->reg_input = input_str;
 
    return (count);
 }
@@ -3971,6 +4177,1135 @@ static unsigned char * next_ptr (unsigned char *ptr) {
    }
 }
 
+/*======================================================================*
+ *  Lazy DFA related code
+ *
+ *  A regex that uses no back references, look-ahead, look-behind or
+ *  general {m,n} counting is regular, and `build_dfa' turns its program
+ *  into a position automaton when it is compiled.  `ExecRE' then runs that
+ *  automaton as a DFA whose states are built on demand, one transition at
+ *  a time, and kept in a bounded cache.  The DFA only tells whether a match
+ *  exists, and whether one can start at a given position; `attempt' still
+ *  does the matching proper, so captured parentheses, extents and the top
+ *  branch come out exactly as they always did.
+ *======================================================================*/
+
+#define DFA_MAX_POSITIONS  2000         /* Larger automata aren't worth it. */
+#define DFA_CACHE_SIZE     (256 * 1024) /* Bytes of states kept per regex.  */
+#define DFA_HASH_SIZE      256
+
+/* Kinds of automaton positions. */
+
+#define DFA_EPSILON        0  /* Go on at each of the epsilon successors.    */
+#define DFA_ASSERT         1  /* Go on at `out' if assertion `op' holds.     */
+#define DFA_CHAR           2  /* Consume a character of the set and go on at
+                                 `out', or go on at the epsilon successors.  */
+#define DFA_ACCEPT         3  /* END of the program reached.                 */
+
+/* Context bits of a DFA state. */
+
+#define DFA_INJECT         1  /* A match may start at the next character.    */
+#define DFA_PREV_BOL       2  /* The previous character ended a line.        */
+#define DFA_PREV_DELIM     4  /* The previous character was a delimiter.     */
+
+#define DFA_GAVE_UP      (-1) /* Cache thrashing, use the backtracker.       */
+
+#define DFA_IN_SET(s,c)  ((s) [(c) >> 3] & (1 << ((c) & 7)))
+#define DFA_ADD_SET(s,c) ((s) [(c) >> 3] |= (unsigned char) (1 << ((c) & 7)))
+
+typedef struct dfa_position {
+   unsigned char kind;
+   unsigned char op;    /* Assertion op code, or IS_DELIM or NOT_DELIM for
+                           the delimiter dependent character sets.        */
+   int           set;   /* Index of the character set, or -1.            */
+   int           out;   /* Successor position for DFA_CHAR, DFA_ASSERT.   */
+   int           eps;   /* First epsilon successor in `eps_list'.         */
+   int           n_eps;
+} dfa_position;
+
+typedef struct dfa_state {
+   struct dfa_state *hash_next;
+   unsigned int      hash;
+   int               index;   /* In the `state' array of the DFA.         */
+   int               flags;   /* DFA_INJECT, DFA_PREV_BOL, DFA_PREV_DELIM   */
+   int               n_pos;
+   int              *pos;     /* Sorted positions to go on from.            */
+   int               trans [1]; /* Per character class, (state << 1) | accept
+                                   or -1 if not computed yet.  More
+                                   chumminess with the compiler.            */
+} dfa_state;
+
+struct regex_dfa {
+   dfa_position   *position;
+   int             n_positions;
+   int             start;
+   int            *eps_list;
+   unsigned char (*set) [32];
+   int             n_sets;
+   int             uses_bol;
+   int             uses_delimiters;
+
+   /* Character classes: characters no position of the automaton can tell
+      apart share a class, and so share the transitions of every state. */
+   int             classes_valid;
+   unsigned char   delimiters [256];
+   unsigned char   class_of [256];
+   unsigned char   class_rep [256];
+   int             n_classes;
+
+   /* The state cache. */
+   dfa_state     **state;
+   int             n_states;
+   int             states_alloc;
+   dfa_state      *hash [DFA_HASH_SIZE];
+   size_t          cache_used;
+   int             flushes;
+   unsigned char  *last_flush;
+
+   /* Work areas for `dfa_closure'. */
+   int            *mark;
+   int            *next_mark;
+   int             generation;
+   int            *stack;
+   int            *next_pos;
+};
+
+/*----------------------------------------------------------------------*
+ * dfa_char_set - fill `set' with the characters `match' would consume at
+ * a simple node with op code `op'.  '\0' is left out, it always ends the
+ * string.  Returns 0 if the set depends on the word delimiters.
+ *----------------------------------------------------------------------*/
+
+static int dfa_char_set (int op, unsigned char *opnd, unsigned char *set) {
+
+   int c, in;
+
+   if (op == IS_DELIM || op == NOT_DELIM) return (0);
+
+   memset (set, 0, 32);
+
+   for (c = 1; c <= (int) UCHAR_MAX; c++) {
+      switch (op) {
+         case EXACTLY:       in = (c == *opnd); break;
+         case SIMILAR:       in = (tolower (c) == *opnd); break;
+         case ANY_OF:        in = (strchr ((char *) opnd, c) != NULL); break;
+         case ANY_BUT:       in = (strchr ((char *) opnd, c) == NULL); break;
+         case ANY:           in = (c != '\n'); break;
+         case EVERY:         in = 1; break;
+         case DIGIT:         in = isdigit (c); break;
+         case NOT_DIGIT:     in = (!isdigit (c) && c != '\n'); break;
+         case LETTER:        in = isalpha (c); break;
+         case NOT_LETTER:    in = (!isalpha (c) && c != '\n'); break;
+         case SPACE:         in = (isspace (c) && c != '\n'); break;
+         case SPACE_NL:      in = isspace (c); break;
+         case NOT_SPACE:     in = !isspace (c); break;
+         case NOT_SPACE_NL:  in = (!isspace (c) || c == '\n'); break;
+         case WORD_CHAR:     in = (isalnum (c) || c == '_'); break;
+         case NOT_WORD_CHAR: in = (!isalnum (c) && c != '_' && c != '\n');
+                             break;
+         default:            in = 0;
+      }
+
+      if (in) DFA_ADD_SET (set, c);
+   }
+
+   return (1);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_quantifier - get the limits and the operand of a simple quantifier
+ * node.  Returns the number of automaton positions the node needs: one
+ * per count of repetitions that has to be told apart.
+ *----------------------------------------------------------------------*/
+
+static int dfa_quantifier (
+   unsigned char  *scan,
+   unsigned long  *min,
+   unsigned long  *max,
+   unsigned char **opnd) {
+
+   switch (GET_OP_CODE (scan)) {
+      case STAR:
+      case LAZY_STAR:
+         *min = REG_ZERO; *max = REG_INFINITY;
+         break;
+
+      case PLUS:
+      case LAZY_PLUS:
+         *min = REG_ONE;  *max = REG_INFINITY;
+         break;
+
+      case QUESTION:
+      case LAZY_QUESTION:
+         *min = REG_ZERO; *max = REG_ONE;
+         break;
+
+      default: /* BRACE, LAZY_BRACE */
+         *min = (unsigned long) GET_OFFSET (scan + NEXT_PTR_SIZE);
+         *max = (unsigned long) GET_OFFSET (scan + (2 * NEXT_PTR_SIZE));
+         *opnd = OPERAND (scan + (2 * NEXT_PTR_SIZE));
+
+         return ((int) ((*max == REG_INFINITY) ? *min : *max) + 1);
+   }
+
+   *opnd = OPERAND (scan);
+
+   return ((int) ((*max == REG_INFINITY) ? *min : *max) + 1);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_node_positions - number of automaton positions for a node, or 0
+ * if the DFA can't handle the node.
+ *----------------------------------------------------------------------*/
+
+static int dfa_node_positions (unsigned char *scan) {
+
+   unsigned long  min, max;
+   unsigned char *opnd;
+   int            op = GET_OP_CODE (scan);
+   int            n;
+
+   if (op == EXACTLY || op == SIMILAR) {
+      return ((int) strlen ((char *) OPERAND (scan)));
+
+   } else if (op >= STAR && op <= LAZY_BRACE) {
+      n = dfa_quantifier (scan, &min, &max, &opnd);
+
+      if (GET_OP_CODE (opnd) < EXACTLY || GET_OP_CODE (opnd) > NOT_DELIM) {
+         return (0);
+      }
+
+      return (n);
+
+   } else if ((op >= BOL   && op <= NOT_BOUNDARY)   ||
+              (op >= ANY_OF && op <= NOT_DELIM)      ||
+               op == END    || op == NOTHING         ||
+               op == BRANCH || op == BACK            ||
+              (op > OPEN  && op < OPEN  + NSUBEXP)   ||
+              (op > CLOSE && op < CLOSE + NSUBEXP)) {
+      return (1);
+   }
+
+   return (0); /* Back references, look-around, {m,n} counting. */
+}
+
+/*----------------------------------------------------------------------*
+ * build_dfa - build the position automaton of a compiled regex of
+ * `size' bytes, along with an empty state cache for its DFA.  Returns
+ * NULL if the regex uses something the DFA can't do, or is too big.
+ *----------------------------------------------------------------------*/
+
+static struct regex_dfa * build_dfa (regexp *prog, unsigned long size) {
+
+   unsigned char     *program = (unsigned char *) prog->program;
+   unsigned char     *scan, *next, *opnd;
+   unsigned char    **node;
+   unsigned char    **todo;
+   unsigned char     *visited;
+   int               *base;
+   struct regex_dfa  *dfa = NULL;
+   dfa_position      *pos;
+   unsigned long      min, max;
+   int                n_nodes = 0, n_todo = 0, n_pos = 0, n_eps = 0;
+   int                i, k, n, op;
+
+   if (program [2] != 0) return (NULL); /* General {m,n} counting. */
+
+   /* Find the nodes the program can reach and number their positions. */
+
+   visited = (unsigned char *) NEditMalloc (size / 8 + 1);
+   node    = (unsigned char **) NEditMalloc (sizeof (unsigned char *) * size);
+   todo    = (unsigned char **) NEditMalloc (sizeof (unsigned char *) * size);
+   base    = (int *) NEditMalloc (sizeof (int) * size);
+
+   memset (visited, 0, size / 8 + 1);
+
+   todo [n_todo++] = program + REGEX_START_OFFSET;
+
+   while (n_todo > 0) {
+      scan = todo [--n_todo];
+      i    = (int) (scan - program);
+
+      if (DFA_IN_SET (visited, i)) continue;
+
+      DFA_ADD_SET (visited, i);
+
+      if ((n = dfa_node_positions (scan)) == 0 ||
+          n_pos + n > DFA_MAX_POSITIONS) goto SINGLE_RETURN;
+
+      node [n_nodes++] = scan;
+      base [i]         = n_pos;
+      n_pos           += n;
+      n_eps           += n; /* At most one each, except for BRANCHes. */
+
+      if ((next = next_ptr (scan)) != NULL) todo [n_todo++] = next;
+
+      if (GET_OP_CODE (scan) == BRANCH) {
+         todo [n_todo++] = OPERAND (scan);
+
+         for (; next != NULL && GET_OP_CODE (next) == BRANCH;
+              next = next_ptr (next)) n_eps++;
+      }
+   }
+
+   dfa = (struct regex_dfa *) NEditMalloc (sizeof (struct regex_dfa));
+   memset (dfa, 0, sizeof (struct regex_dfa));
+
+   dfa->n_positions = n_pos;
+   dfa->start       = base [REGEX_START_OFFSET];
+   dfa->position    = (dfa_position *) NEditMalloc (sizeof (dfa_position) *
+                                                    n_pos);
+   dfa->eps_list    = (int *) NEditMalloc (sizeof (int) * n_eps);
+   dfa->set         = (unsigned char (*) [32]) NEditMalloc (32 * n_pos);
+   dfa->mark        = (int *) NEditMalloc (sizeof (int) * n_pos);
+   dfa->next_mark   = (int *) NEditMalloc (sizeof (int) * n_pos);
+   dfa->stack       = (int *) NEditMalloc (sizeof (int) * n_pos);
+   dfa->next_pos    = (int *) NEditMalloc (sizeof (int) * n_pos);
+
+   memset (dfa->mark,      0, sizeof (int) * n_pos);
+   memset (dfa->next_mark, 0, sizeof (int) * n_pos);
+
+   n_eps = 0;
+
+   for (i = 0; i < n_nodes; i++) {
+      scan = node [i];
+      op   = GET_OP_CODE (scan);
+      next = next_ptr (scan);
+      n    = dfa_node_positions (scan);
+
+      for (k = 0, pos = &dfa->position [base [scan - program]]; k < n;
+           k++, pos++) {
+         pos->kind  = DFA_EPSILON;
+         pos->op    = 0;
+         pos->set   = -1;
+         pos->out   = -1;
+         pos->eps   = n_eps;
+         pos->n_eps = 0;
+      }
+
+      pos = &dfa->position [base [scan - program]];
+
+      if (op == BRANCH) {
+         /* Same choices as `match' makes. */
+
+         if (next == NULL || GET_OP_CODE (next) != BRANCH) {
+            dfa->eps_list [n_eps++] = base [OPERAND (scan) - program];
+         } else {
+            for (next = scan; next != NULL && GET_OP_CODE (next) == BRANCH;
+                 next = next_ptr (next)) {
+               dfa->eps_list [n_eps++] = base [OPERAND (next) - program];
+            }
+         }
+
+         pos->n_eps = n_eps - pos->eps;
+
+      } else if (op == END) {
+         pos->kind = DFA_ACCEPT;
+
+      } else if (op >= BOL && op <= NOT_BOUNDARY) {
+         pos->kind = DFA_ASSERT;
+         pos->op   = (unsigned char) op;
+         pos->out  = base [next - program];
+
+         if (op == BOL) {
+            dfa->uses_bol = 1;
+         } else if (op != EOL) {
+            dfa->uses_delimiters = 1;
+         }
+
+      } else if (op == EXACTLY || op == SIMILAR) {
+         /* Position k matches the k-th character of the string. */
+
+         opnd = OPERAND (scan);
+
+         for (k = 0; k < n; k++, pos++) {
+            pos->kind = DFA_CHAR;
+            pos->set  = dfa->n_sets++;
+            pos->out  = (k + 1 < n) ? base [scan - program] + k + 1 :
+                                      base [next - program];
+
+            dfa_char_set (op, opnd + k, dfa->set [pos->set]);
+         }
+
+      } else if (op >= STAR && op <= LAZY_BRACE) {
+         /* Position k stands for k repetitions matched so far.  Without a
+            maximum, counts past the minimum needn't be told apart.  Lazy or
+            greedy makes no difference to whether there is a match. */
+
+         dfa_quantifier (scan, &min, &max, &opnd);
+
+         for (k = 0; k < n; k++, pos++) {
+            if (max == REG_INFINITY || (unsigned long) k < max) {
+               pos->kind = DFA_CHAR;
+               pos->out  = base [scan - program] + ((k + 1 < n) ? k + 1 : k);
+
+               if (dfa_char_set (GET_OP_CODE (opnd), OPERAND (opnd),
+                                 dfa->set [dfa->n_sets])) {
+                  pos->set = dfa->n_sets++;
+               } else {
+                  pos->op  = GET_OP_CODE (opnd);
+                  dfa->uses_delimiters = 1;
+               }
+            }
+
+            if ((unsigned long) k >= min) {
+               pos->eps   = n_eps;
+               pos->n_eps = 1;
+               dfa->eps_list [n_eps++] = base [next - program];
+            }
+         }
+
+      } else if (op >= ANY_OF && op <= NOT_DELIM) {
+         pos->kind = DFA_CHAR;
+         pos->out  = base [next - program];
+
+         if (dfa_char_set (op, OPERAND (scan), dfa->set [dfa->n_sets])) {
+            pos->set = dfa->n_sets++;
+         } else {
+            pos->op  = (unsigned char) op;
+            dfa->uses_delimiters = 1;
+         }
+
+      } else {
+         /* NOTHING, BACK, OPEN and CLOSE just lead on to the next node. */
+
+         pos->n_eps = 1;
+         dfa->eps_list [n_eps++] = base [next - program];
+      }
+   }
+
+   SINGLE_RETURN:
+
+   NEditFree (visited);
+   NEditFree (node);
+   NEditFree (todo);
+   NEditFree (base);
+
+   return (dfa);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_flush - empty the state cache of a DFA.
+ *----------------------------------------------------------------------*/
+
+static void dfa_flush (struct regex_dfa *dfa) {
+
+   int i;
+
+   for (i = 0; i < dfa->n_states; i++) NEditFree (dfa->state [i]);
+
+   dfa->n_states   = 0;
+   dfa->cache_used = 0;
+   memset (dfa->hash, 0, sizeof (dfa->hash));
+}
+
+/*----------------------------------------------------------------------*
+ * free_dfa - free a DFA and its state cache.
+ *----------------------------------------------------------------------*/
+
+static void free_dfa (struct regex_dfa *dfa) {
+
+   if (dfa == NULL) return;
+
+   dfa_flush (dfa);
+
+   NEditFree (dfa->state);
+   NEditFree (dfa->position);
+   NEditFree (dfa->eps_list);
+   NEditFree (dfa->set);
+   NEditFree (dfa->mark);
+   NEditFree (dfa->next_mark);
+   NEditFree (dfa->stack);
+   NEditFree (dfa->next_pos);
+   NEditFree (dfa);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_prepare - get a DFA ready for a search with the current word
+ * delimiters.  The character classes (and so every cached transition)
+ * depend on them when the regex uses <, >, \B, \y or \Y.
+ *----------------------------------------------------------------------*/
+
+static void dfa_prepare (regexContext *ctx, struct regex_dfa *dfa) {
+
+   unsigned char new_class [256];
+   int           remap [512];
+   int           i, c, in, n;
+
+   if (dfa->classes_valid &&
+       (!dfa->uses_delimiters ||
+        memcmp (dfa->delimiters, ctx->current_delimiters, 256) == 0)) return;
+
+   dfa_flush (dfa);
+
+   memcpy (dfa->delimiters, ctx->current_delimiters, 256);
+
+   /* Split the characters into classes by refining the partition with
+      every set a position can test: '\0' (the end of the string), '\n'
+      (for ^ and $), the delimiters and each character set. */
+
+   memset (dfa->class_of, 0, 256);
+   dfa->n_classes = 1;
+
+   for (i = -3; i < dfa->n_sets; i++) {
+      if (i == -1 && !dfa->uses_delimiters) continue;
+
+      for (c = 0; c < 512; c++) remap [c] = -1;
+
+      for (c = 0, n = 0; c < 256; c++) {
+         switch (i) {
+            case -3: in = (c == '\0'); break;
+            case -2: in = (c == '\n'); break;
+            case -1: in = (ctx->current_delimiters [c] != 0); break;
+            default: in = (DFA_IN_SET (dfa->set [i], c) != 0);
+         }
+
+         if (remap [dfa->class_of [c] * 2 + in] < 0) {
+            remap [dfa->class_of [c] * 2 + in] = n++;
+         }
+
+         new_class [c] = (unsigned char) remap [dfa->class_of [c] * 2 + in];
+      }
+
+      memcpy (dfa->class_of, new_class, 256);
+      dfa->n_classes = n;
+   }
+
+   for (c = 255; c >= 0; c--) dfa->class_rep [dfa->class_of [c]] = c;
+
+   dfa->classes_valid = 1;
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_context - the context bits for a match position: whether the
+ * preceding character ends a line and whether it is a word delimiter.
+ * Only the bits the regex can test are set, to keep states few.
+ *----------------------------------------------------------------------*/
+
+static int dfa_context (
+   regexContext     *ctx,
+   struct regex_dfa *dfa,
+   unsigned char    *str) {
+
+   int flags = 0;
+
+   if (str == ctx->start_of_string) {
+      if (ctx->prev_is_bol)   flags |= DFA_PREV_BOL;
+      if (ctx->prev_is_delim) flags |= DFA_PREV_DELIM;
+   } else {
+      if (*(str - 1) == '\n')             flags |= DFA_PREV_BOL;
+      if (ctx->current_delimiters [*(str - 1)]) flags |= DFA_PREV_DELIM;
+   }
+
+   if (!dfa->uses_bol)        flags &= ~DFA_PREV_BOL;
+   if (!dfa->uses_delimiters) flags &= ~DFA_PREV_DELIM;
+
+   return (flags);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_compare_int - qsort comparison for position numbers.
+ *----------------------------------------------------------------------*/
+
+static int dfa_compare_int (const void *a, const void *b) {
+
+   return (*(const int *) a - *(const int *) b);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_get_state - find the state with the given positions and context
+ * bits in the cache, or add it.  If the cache is full it is flushed
+ * first, which invalidates every state pointer the caller may hold;
+ * `str' is the position reached in the search.  Returns NULL when the
+ * cache gets flushed too often to be of use.
+ *----------------------------------------------------------------------*/
+
+static dfa_state * dfa_get_state (
+   struct regex_dfa *dfa,
+   int              *pos,
+   int               n_pos,
+   int               flags,
+   unsigned char    *str) {
+
+   unsigned int  hash = (unsigned int) flags;
+   dfa_state    *state;
+   size_t        state_size;
+   int           i;
+
+   for (i = 0; i < n_pos; i++) hash = hash * 31U + (unsigned int) pos [i];
+
+   for (state = dfa->hash [hash % DFA_HASH_SIZE]; state != NULL;
+        state = state->hash_next) {
+
+      if (state->hash == hash && state->flags == flags &&
+          state->n_pos == n_pos &&
+          memcmp (state->pos, pos, sizeof (int) * n_pos) == 0) {
+
+         return (state);
+      }
+   }
+
+   state_size = sizeof (dfa_state) + sizeof (int) * (dfa->n_classes - 1) +
+                sizeof (int) * n_pos;
+
+   if (dfa->cache_used + state_size > DFA_CACHE_SIZE && dfa->n_states > 0) {
+      /* Give up if the cache didn't last for a good stretch of text. */
+
+      if (dfa->last_flush != NULL &&
+          str - dfa->last_flush < 10 * dfa->n_states) return (NULL);
+
+      dfa->last_flush = str;
+      dfa->flushes++;
+      dfa_flush (dfa);
+   }
+
+   if (dfa->n_states == dfa->states_alloc) {
+      dfa->states_alloc = dfa->states_alloc ? 2 * dfa->states_alloc : 64;
+      dfa->state        = (dfa_state **) NEditRealloc (dfa->state,
+                             sizeof (dfa_state *) * dfa->states_alloc);
+   }
+
+   state = (dfa_state *) NEditMalloc (state_size);
+
+   state->hash  = hash;
+   state->index = dfa->n_states;
+   state->flags = flags;
+   state->n_pos = n_pos;
+   state->pos   = &state->trans [dfa->n_classes];
+
+   memcpy (state->pos, pos, sizeof (int) * n_pos);
+
+   for (i = 0; i < dfa->n_classes; i++) state->trans [i] = -1;
+
+   state->hash_next = dfa->hash [hash % DFA_HASH_SIZE];
+   dfa->hash [hash % DFA_HASH_SIZE] = state;
+
+   dfa->state [dfa->n_states++] = state;
+   dfa->cache_used += state_size;
+
+   return (state);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_closure - follow the epsilon transitions from the positions of a
+ * state (and from the start of the regex, if a match may start here)
+ * given the character `c' at the current position, or the end of the
+ * string if `at_end' is set.  Unless at the end, the positions reached
+ * by consuming `c' are left in `dfa->next_pos'; their number is stored
+ * in `n_next'.  Returns whether the END of the regex was reached.
+ *----------------------------------------------------------------------*/
+
+static int dfa_closure (
+   regexContext     *ctx,
+   struct regex_dfa *dfa,
+   dfa_state        *state,
+   unsigned char     c,
+   int               at_end,
+   int              *n_next) {
+
+   dfa_position *pos;
+   int           n_stack = 0, n = 0, accept = 0;
+   int           i, p, prev_delim, cur_delim, holds;
+
+   if (++dfa->generation == INT_MAX) {
+      memset (dfa->mark,      0, sizeof (int) * dfa->n_positions);
+      memset (dfa->next_mark, 0, sizeof (int) * dfa->n_positions);
+      dfa->generation = 1;
+   }
+
+   prev_delim = (state->flags & DFA_PREV_DELIM) != 0;
+   cur_delim  = at_end ? ctx->succ_is_delim : ctx->current_delimiters [c];
+
+   for (i = 0; i < state->n_pos; i++) {
+      dfa->mark  [state->pos [i]] = dfa->generation;
+      dfa->stack [n_stack++]      = state->pos [i];
+   }
+
+   if ((state->flags & DFA_INJECT) &&
+       dfa->mark [dfa->start] != dfa->generation) {
+      dfa->mark  [dfa->start] = dfa->generation;
+      dfa->stack [n_stack++]  = dfa->start;
+   }
+
+   while (n_stack > 0) {
+      pos = &dfa->position [dfa->stack [--n_stack]];
+
+      switch (pos->kind) {
+         case DFA_ACCEPT:
+            accept = 1;
+            continue;
+
+         case DFA_ASSERT:
+            switch (pos->op) {
+               case BOL:
+                  holds = (state->flags & DFA_PREV_BOL) != 0; break;
+               case EOL:
+                  holds = (c == '\n' || (at_end && ctx->succ_is_eol)); break;
+               case BOWORD:
+                  holds = (prev_delim && !cur_delim); break;
+               case EOWORD:
+                  holds = (!prev_delim && cur_delim); break;
+               default: /* NOT_BOUNDARY */
+                  holds = (prev_delim == cur_delim);
+            }
+
+            if (holds && dfa->mark [pos->out] != dfa->generation) {
+               dfa->mark  [pos->out]  = dfa->generation;
+               dfa->stack [n_stack++] = pos->out;
+            }
+
+            continue;
+
+         case DFA_CHAR:
+            if (at_end || pos->out < 0) {
+               holds = 0;
+            } else if (pos->set >= 0) {
+               holds = DFA_IN_SET (dfa->set [pos->set], c) != 0;
+            } else if (pos->op == IS_DELIM) {
+               holds = ctx->current_delimiters [c] != 0;
+            } else {
+               holds = ctx->current_delimiters [c] == 0;
+            }
+
+            if (holds && dfa->next_mark [pos->out] != dfa->generation) {
+               dfa->next_mark [pos->out] = dfa->generation;
+               dfa->next_pos  [n++]      = pos->out;
+            }
+
+            break; /* On to the epsilon transitions, if any. */
+      }
+
+      for (i = pos->eps; i < pos->eps + pos->n_eps; i++) {
+         p = dfa->eps_list [i];
+
+         if (dfa->mark [p] != dfa->generation) {
+            dfa->mark  [p]         = dfa->generation;
+            dfa->stack [n_stack++] = p;
+         }
+      }
+   }
+
+   if (n > 1) qsort (dfa->next_pos, n, sizeof (int), dfa_compare_int);
+
+   *n_next = n;
+
+   return (accept);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_step - compute (and cache) the transition of a state on the
+ * character at `str'.  Sets `accept' if a match ends before it.
+ * Returns NULL if the DFA gave up.
+ *----------------------------------------------------------------------*/
+
+static dfa_state * dfa_step (
+   regexContext     *ctx,
+   struct regex_dfa *dfa,
+   dfa_state        *state,
+   unsigned char    *str,
+   int              *accept) {
+
+   dfa_state *next;
+   int        n_next, flags, flushes;
+
+   *accept = dfa_closure (ctx, dfa, state, *str, 0, &n_next);
+
+   flags = state->flags & DFA_INJECT;
+
+   if (dfa->uses_bol && *str == '\n') flags |= DFA_PREV_BOL;
+
+   if (dfa->uses_delimiters && ctx->current_delimiters [*str]) {
+      flags |= DFA_PREV_DELIM;
+   }
+
+   flushes = dfa->flushes;
+   next    = dfa_get_state (dfa, dfa->next_pos, n_next, flags, str);
+
+   /* Remember the transition, unless the cache was flushed underneath. */
+
+   if (next != NULL && dfa->flushes == flushes) {
+      state->trans [dfa->class_of [*str]] = (next->index << 1) | *accept;
+   }
+
+   return (next);
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_run - run the DFA from `state' at `str' until the fate of the
+ * search is known.  While the state has DFA_INJECT set, matches may start
+ * anywhere up to `end' (if not NULL).  Transitions already in the cache
+ * are followed by a tight loop; those that aren't (nor ever are: the end
+ * of the string, and leaving a dead state) drop out of it.  Returns 1 if
+ * a match was found, 0 if none can be, or DFA_GAVE_UP.
+ *----------------------------------------------------------------------*/
+
+static int dfa_run (
+   regexContext     *ctx,
+   struct regex_dfa *dfa,
+   dfa_state        *state,
+   unsigned char    *str,
+   unsigned char    *end) {
+
+   unsigned char *stop;
+   int            trans, accept, n_next;
+
+   for (;;) {
+      if ((state->flags & DFA_INJECT) && end != NULL && str > end) {
+         /* No more matches may start from here on. */
+
+         memcpy (dfa->next_pos, state->pos, sizeof (int) * state->n_pos);
+
+         state = dfa_get_state (dfa, dfa->next_pos, state->n_pos,
+                                state->flags & ~DFA_INJECT, str);
+
+         if (state == NULL) return (DFA_GAVE_UP);
+      }
+
+      if (state->n_pos == 0 && !(state->flags & DFA_INJECT)) return (0);
+
+      if (AT_END_OF_STRING (str)) {
+         return (dfa_closure (ctx, dfa, state, *str, 1, &n_next));
+      }
+
+      if (state->trans [dfa->class_of [*str]] < 0) {
+         state = dfa_step (ctx, dfa, state, str, &accept);
+
+         if (accept) return (1);
+
+         if (state == NULL) return (DFA_GAVE_UP);
+
+         str++;
+         continue;
+      }
+
+      stop = ((state->flags & DFA_INJECT) && end != NULL) ? end + 1 :
+                                                            ctx->end_of_string;
+
+      do {
+         if ((trans = state->trans [dfa->class_of [*str]]) < 0) break;
+
+         if (trans & 1) return (1);
+
+         state = dfa->state [trans >> 1];
+      } while (++str != stop);
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_search - find out whether the regex matches anywhere in the
+ * string, with the match starting no later than `end' (if not NULL).
+ * Returns 1 if it does, 0 if it doesn't, or DFA_GAVE_UP.
+ *----------------------------------------------------------------------*/
+
+static int dfa_search (
+   regexContext     *ctx,
+   struct regex_dfa *dfa,
+   unsigned char    *string,
+   unsigned char    *end) {
+
+   dfa_state *state;
+   int        flags;
+
+   dfa_prepare (ctx, dfa);
+   dfa->last_flush = NULL;
+
+   flags = dfa_context (ctx, dfa, string);
+
+   if (end == NULL || string <= end) flags |= DFA_INJECT;
+
+   state = dfa_get_state (dfa, dfa->next_pos, 0, flags, string);
+
+   if (state == NULL) return (DFA_GAVE_UP);
+
+   return (dfa_run (ctx, dfa, state, string, end));
+}
+
+/*----------------------------------------------------------------------*
+ * dfa_matches_at - find out whether a match can start at `str'.
+ * Returns 1 if one can, 0 if not, or DFA_GAVE_UP.
+ *----------------------------------------------------------------------*/
+
+static int dfa_matches_at (
+   regexContext     *ctx,
+   struct regex_dfa *dfa,
+   unsigned char    *str) {
+
+   dfa_state *state;
+
+   dfa->last_flush   = NULL;
+   dfa->next_pos [0] = dfa->start;
+
+   state = dfa_get_state (dfa, dfa->next_pos, 1,
+                          dfa_context (ctx, dfa, str), str);
+
+   if (state == NULL) return (DFA_GAVE_UP);
+
+   return (dfa_run (ctx, dfa, state, str, NULL));
+}
+
+/*======================================================================*
+ *  Required literal related code
+ *
+ *  Most regexes people search with contain a literal string, and every
+ *  match has to contain it at a more or less fixed distance from its
+ *  start, as in `ERROR\s+\d+' or `^\s*#\s*include'.  `required_literal'
+ *  digs that string out of the program when it is compiled, and
+ *  `literal_skip' lets `ExecRE' look for it with the vectorized scanning
+ *  kernels of textScan.c instead of attempting a match at every
+ *  character on the way to it.
+ *======================================================================*/
+
+#define LITERAL_CHUNK 65536 /* Bytes looked at per scan for the literal. */
+
+/*----------------------------------------------------------------------*
+ * required_literal - find the literal string every match of `prog'
+ * must contain, and fill in the `literal' fields of `prog'.
+ *
+ * Only the nodes every match passes through are considered: those of
+ * the one top-level alternative up to the first construct that can
+ * match more than one way or an unpredictable number of characters.
+ * Literals whose distance from the start of the match is bounded are
+ * preferred, since they tell where a match can start; among those (or
+ * failing those), the longest one wins.
+ *----------------------------------------------------------------------*/
+
+static void required_literal (regexp *prog) {
+
+   unsigned char *scan, *opnd, *lit;
+   unsigned long  min, max;
+   long           lo = 0, hi = 0; /* Distance from the start of the match. */
+   int            op, len, c, i, n_lead, rank, best_rank;
+
+   prog->literal     = NULL;
+   prog->literal_len = 0;
+   prog->literal_min = 0;
+   prog->literal_max = -1;
+   prog->literal_ci  = 0;
+
+   prog->literal_lead_at = 0;
+
+   scan = (unsigned char *) (prog->program + REGEX_START_OFFSET);
+
+   while (scan != NULL) {
+      op = GET_OP_CODE (scan);
+
+      if (op == BRANCH) {
+         if (GET_OP_CODE (next_ptr (scan)) == BRANCH) break; /* Alternation */
+
+         scan = OPERAND (scan); /* Only one choice, so go on with it. */
+         continue;
+
+      } else if (op == EXACTLY || op == SIMILAR) {
+         len = (int) strlen ((char *) OPERAND (scan));
+
+         if (prog->literal == NULL                            ||
+             (hi >= 0 && prog->literal_max < 0)               ||
+             ((hi >= 0) == (prog->literal_max >= 0) &&
+              len > prog->literal_len)) {
+
+            prog->literal     = (char *) OPERAND (scan);
+            prog->literal_len = len;
+            prog->literal_min = (int) lo;
+            prog->literal_max = (int) hi;
+            prog->literal_ci  = (op == SIMILAR);
+         }
+
+         lo += len;
+         if (hi >= 0) hi += len;
+
+      } else if (op >= ANY_OF && op <= NOT_DELIM) {
+         lo++;
+         if (hi >= 0) hi++;
+
+      } else if (op >= STAR && op <= LAZY_BRACE) {
+         /* Operands of these are always a single character wide. */
+
+         dfa_quantifier (scan, &min, &max, &opnd);
+
+         lo += (long) min;
+
+         if (max == REG_INFINITY) {
+            hi = -1;
+         } else if (hi >= 0) {
+            hi += (long) max;
+         }
+
+      } else if (!((op >= BOL  && op <= NOT_BOUNDARY) || op == NOTHING ||
+                   (op > OPEN  && op < OPEN  + NSUBEXP)                ||
+                   (op > CLOSE && op < CLOSE + NSUBEXP))) {
+
+         break; /* END, loops, counting, back references and look-around */
+      }
+
+      if (lo > INT_MAX / 2 || hi > INT_MAX / 2) break;
+
+      scan = next_ptr (scan);
+   }
+
+   if (prog->literal == NULL) return;
+
+   /* Scan for the character of the literal least likely to turn up by
+      chance, so fewer false leads have to be checked: punctuation before
+      upper case letters, digits, lower case letters and white space. */
+
+   lit = (unsigned char *) prog->literal;
+
+   for (i = 0, best_rank = -1; i < prog->literal_len; i++) {
+      if (isspace (lit [i])) {
+         rank = 0;
+      } else if (islower (lit [i])) {
+         rank = (prog->literal_ci ? 0 : 1);
+      } else if (isdigit (lit [i])) {
+         rank = 2;
+      } else if (isupper (lit [i])) {
+         rank = 3;
+      } else {
+         rank = 4;
+      }
+
+      if (rank > best_rank) {
+         best_rank             = rank;
+         prog->literal_lead_at = i;
+      }
+   }
+
+   /* Find the characters that can stand for it in the text. */
+
+   if (!prog->literal_ci) {
+      prog->literal_lead [0] = (char) lit [prog->literal_lead_at];
+      prog->literal_lead [1] = '\0';
+
+      return;
+   }
+
+   for (c = 1, n_lead = 0; c <= UCHAR_MAX; c++) {
+      if (tolower (c) == lit [prog->literal_lead_at]) {
+         if (n_lead == (int) sizeof (prog->literal_lead) - 1) {
+            prog->literal = NULL; /* Too many to look for at once. */
+
+            return;
+         }
+
+         prog->literal_lead [n_lead++] = (char) c;
+      }
+   }
+
+   prog->literal_lead [n_lead] = '\0';
+}
+
+/*----------------------------------------------------------------------*
+ * find_literal - find the first occurrence of the required literal of
+ * `prog' at or after `from' that lies entirely within the string being
+ * searched.  Returns NULL if there is none.
+ *
+ * The end of the string isn't known in advance when `end_of_string' is
+ * NULL (and the string may hold a '\0' before it anyway), so the text
+ * is taken LITERAL_CHUNK bytes at a time, and each chunk is cut short
+ * at the first '\0' in it.
+ *----------------------------------------------------------------------*/
+
+static unsigned char * find_literal (
+   regexContext  *ctx,
+   regexp        *prog,
+   unsigned char *from) {
+
+   unsigned char *lit = (unsigned char *) prog->literal;
+   int            len = prog->literal_len;
+   int            at  = prog->literal_lead_at;
+   unsigned char *p, *limit, *nul;
+   long           chunk;
+   int            last, i;
+
+   for (;;) {
+      chunk = LITERAL_CHUNK;
+      last  = 0;
+
+      if (ctx->end_of_string != NULL && ctx->end_of_string - from <= chunk) {
+         if (ctx->end_of_string <= from) return (NULL);
+
+         chunk = ctx->end_of_string - from;
+         last  = 1;
+      }
+
+      if ((nul = (unsigned char *) memchr (from, '\0', (size_t) chunk)) != NULL) {
+         chunk = nul - from;
+         last  = 1;
+      }
+
+      limit = from + chunk;
+
+      /* `p' is where the literal would begin, `p + at' the character
+         scanned for. */
+
+      for (p = from; limit - p >= len; p++) {
+         if (prog->literal_ci) {
+            p = (unsigned char *) ScanFindAnyChar ((char *) p + at,
+                   (int) (limit - p) - len + 1, prog->literal_lead);
+         } else {
+            p = (unsigned char *) ScanFindChar ((char *) p + at,
+                   (int) (limit - p) - len + 1, (char) lit [at]);
+         }
+
+         if (p == NULL) break;
+
+         p -= at;
+
+         if (prog->literal_ci) {
+            for (i = 0; i < len && tolower (p [i]) == lit [i]; i++) ;
+
+            if (i == len) return (p);
+
+         } else if (memcmp (p, lit, (size_t) len) == 0) {
+            return (p);
+         }
+      }
+
+      if (last) return (NULL);
+
+      /* Look again from where an occurrence straddling the end of this
+         chunk would begin. */
+
+      from = limit - (len - 1);
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * literal_skip - find the first position at or after `str' where a
+ * match of `prog' could start as far as its required literal is
+ * concerned.  Returns NULL if no match can start at or after `str'.
+ *
+ * Calls made by one `ExecRE' must come with `str' never decreasing,
+ * since the last occurrence of the literal found is kept in
+ * `literal_at'.
+ *----------------------------------------------------------------------*/
+
+static unsigned char * literal_skip (
+   regexContext  *ctx,
+   regexp        *prog,
+   unsigned char *str) {
+
+   unsigned char *from = str;
+   int            i;
+
+   if (ctx->literal_at == NULL || ctx->literal_at - str < prog->literal_min) {
+      /* Step over the characters that must come before the literal. */
+
+      for (i = 0; i < prog->literal_min; i++, from++) {
+         if (AT_END_OF_STRING (from)) return (NULL);
+      }
+
+      ctx->literal_at = find_literal (ctx, prog, from);
+
+      if (ctx->literal_at == NULL) return (NULL);
+   }
+
+   if (prog->literal_max >= 0 && ctx->literal_at - str > prog->literal_max) {
+      return (ctx->literal_at - prog->literal_max);
+   }
+
+   return (str);
+}
+
 /*
 **  SubstituteRE - Perform substitutions after a `regexp' match.
 **
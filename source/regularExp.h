@@ -47,6 +47,14 @@ typedef struct regexp {
                                positive look-ahead.) */
    int   top_branch;        /* Zero-based index of the top branch that matches.
                                Used by syntax highlighting only. */
+   struct regex_dfa *dfa;   /* Internal use only. */
+   char *literal;           /* Internal use only. */
+   int   literal_len;       /* Internal use only. */
+   int   literal_min;       /* Internal use only. */
+   int   literal_max;       /* Internal use only. */
+   int   literal_lead_at;   /* Internal use only. */
+   char  literal_lead [8];  /* Internal use only. */
+   char  literal_ci;        /* Internal use only. */
    char  match_start;       /* Internal use only. */
    char  anchor;            /* Internal use only. */
    char  program [1];       /* Unwarranted chumminess with compiler. */
@@ -67,6 +75,10 @@ regexp * CompileRE (
    char **errorText,   /* Text of any error message produced. */
    int  defaultFlags); /* Flags for default RE-operation */
 
+/* Frees a `regexp' structure compiled by `CompileRE'. */
+
+void FreeRE (regexp *prog);
+
 /* Match a `regexp' structure against a string. */
 
 int ExecRE (
@@ -86,6 +98,35 @@ int ExecRE (
                                    \0 is assumed to be the boundary if not
                                    set. Lookahead can cross the boundary. */
 
+/* State of a match in progress.  `ExecRE' keeps its own in a static, so
+   threads matching at the same time must each use `ExecREWithContext' with
+   a context (and compiled regexes) of their own.  `CompileRE' and
+   `SetREDefaultWordDelimiters' must still be called from one thread only. */
+
+typedef struct regex_context regexContext;
+
+/* Creates a context for `ExecREWithContext'. */
+
+regexContext * NewREContext (void);
+
+/* Frees a context created by `NewREContext'. */
+
+void FreeREContext (regexContext *ctx);
+
+/* `ExecRE', keeping the state of the match in `ctx'. */
+
+int ExecREWithContext (
+   regexContext *ctx,           /* Context created by `NewREContext'. */
+   regexp *prog,
+   const char   *string,
+   const char   *end,
+   int     reverse,
+   char    prev_char,
+   char    succ_char,
+   const char   *delimiters,
+   const char   *look_behind_to,
+   const char   *match_till);
+
 /* Perform substitutions after a `regexp' match. */
 Boolean SubstituteRE(const regexp* prog, const char* source, char* dest,
         int max);
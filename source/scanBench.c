@@ -0,0 +1,166 @@
+/*******************************************************************************
+*                                                                              *
+* scanBench.c -- Throughput benchmark for the text scanning kernels            *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute version of this program linked to   *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License        *
+* for more details.                                                            *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Usage: scanbench [megabytes [repeats]]
+**
+** Fills a buffer with text resembling source code, and times each of the
+** scanning kernels of textScan.c over it with every kernel set this machine
+** supports, reporting throughput in GB/s.  Built with "make scanbench" in
+** the source directory; it isn't part of the nedit executable.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "textScan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DEFAULT_MEGABYTES 64
+#define DEFAULT_REPEATS 5
+
+static double seconds(void);
+static void fillText(char *text, int length);
+static void report(const char *kernelName, const char *test, double bytes,
+        double elapsed, long result);
+
+int main(int argc, char **argv)
+{
+    int megabytes = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    int repeats = argc > 2 ? atoi(argv[2]) : DEFAULT_REPEATS;
+    int type, i, length, nFound;
+    long result;
+    double start, bytes;
+    char *text, present[256];
+    const char *name;
+
+    if (megabytes <= 0 || megabytes > 1024 || repeats <= 0) {
+        fprintf(stderr, "usage: scanbench [megabytes [repeats]]\n");
+        return 1;
+    }
+    length = megabytes * 1024 * 1024;
+    text = (char *)malloc(length);
+    if (text == NULL) {
+        fprintf(stderr, "scanbench: can't allocate %d MB\n", megabytes);
+        return 1;
+    }
+    fillText(text, length);
+    bytes = (double)length * repeats;
+
+    printf("%-10s %-20s %10s %14s\n", "kernels", "test", "GB/s", "result");
+    for (type = 0; type < N_SCAN_KERNEL_TYPES; type++) {
+        if ((name = ScanKernelsName(type)) == NULL ||
+                ScanSelectKernels(type) != type)
+            continue;
+
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++)
+            result += ScanCountChar(text, length, '\n');
+        report(name, "count newlines", bytes, seconds() - start, result);
+
+        /* the text holds no '\001' characters, so searches for one go all
+           the way through it */
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++)
+            result += ScanFindChar(text, length, '\001') == NULL;
+        report(name, "find char", bytes, seconds() - start, result);
+
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++)
+            result += ScanFindCharBackward(text, length, '\001') == NULL;
+        report(name, "find char backward", bytes, seconds() - start, result);
+
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++)
+            result += ScanFindAnyChar(text, length, "\001\002\003") == NULL;
+        report(name, "find any of 3", bytes, seconds() - start, result);
+
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++)
+            result += ScanFindAnyCharBackward(text, length,
+                    "\001\002\003") == NULL;
+        report(name, "find any backward", bytes, seconds() - start, result);
+
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++) {
+            ScanFindNthChar(text, length, '\n', length, &nFound);
+            result += nFound;
+        }
+        report(name, "find nth newline", bytes, seconds() - start, result);
+
+        start = seconds();
+        for (i = 0, result = 0; i < repeats; i++) {
+            memset(present, 0, sizeof(present));
+            ScanMarkChars(text, length, present);
+            result += present['\n'];
+        }
+        report(name, "mark chars", bytes, seconds() - start, result);
+    }
+    free(text);
+    return 0;
+}
+
+static double seconds(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1e6;
+}
+
+/*
+** Fill "text" with lines of random words of lower case letters, indented
+** with tabs and spaces, averaging about 40 characters a line
+*/
+static void fillText(char *text, int length)
+{
+    int i, column = 0;
+    unsigned seed = 12345;
+
+    for (i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        if (column > 8 && (seed >> 16) % 40 == 0) {
+            text[i] = '\n';
+            column = 0;
+        } else if (column == 0 && (seed >> 16) % 3 == 0) {
+            text[i] = '\t';
+        } else {
+            text[i] = (seed >> 16) % 6 == 0 ? ' ' : 'a' + (seed >> 16) % 26;
+            column++;
+        }
+    }
+}
+
+static void report(const char *kernelName, const char *test, double bytes,
+        double elapsed, long result)
+{
+    printf("%-10s %-20s %10.2f %14ld\n", kernelName, test,
+            elapsed > 0 ? bytes / elapsed / 1e9 : 0.0, result);
+}
@@ -2623,7 +2623,7 @@ static int getReplaceDlogInfo(WindowInfo *window, int *direction,
 	  NEditFree(replaceWithText);
  	  return FALSE;
       }
-      NEditFree(compiledRE);
+      FreeRE(compiledRE);
     } else {
       if(XmToggleButtonGetState(window->replaceCaseToggle)) {
       	if(XmToggleButtonGetState(window->replaceWordToggle))
@@ -2698,7 +2698,7 @@ static int getFindDlogInfo(WindowInfo *window, int *direction,
                   "Please respecify the search string:\n%s", "OK", compileMsg);
  	  return FALSE;
       }
-      NEditFree(compiledRE);
+      FreeRE(compiledRE);
     } else {
       if(XmToggleButtonGetState(window->findCaseToggle)) {
       	if(XmToggleButtonGetState(window->findWordToggle))
@@ -3229,7 +3229,7 @@ static void iSearchTextValueChangedCB(Widget w, WindowInfo *window,
 	    NEditFree(searchString);
 	    return;
 	}
-	NEditFree(compiledRE);
+	FreeRE(compiledRE);
     }
     
     /* Call the incremental search action proc to do the searching and
@@ -4526,13 +4526,13 @@ static int forwardRegexSearch(const char *string, const char *searchString, int
 	    *searchExtentFW = compiledRE->extentpFW - string;
 	if (searchExtentBW != NULL)
            *searchExtentBW = compiledRE->extentpBW - string;
-	NEditFree(compiledRE);
+	FreeRE(compiledRE);
 	return TRUE;
     }
     
     /* if wrap turned off, we're done */
     if (!wrap) {
-    	NEditFree(compiledRE);
+    	FreeRE(compiledRE);
 	return FALSE;
     }
     
@@ -4545,11 +4545,11 @@ static int forwardRegexSearch(const char *string, const char *searchString, int
        	    *searchExtentFW = compiledRE->extentpFW - string;
 	if (searchExtentBW != NULL)
 	    *searchExtentBW = compiledRE->extentpBW - string;
-	NEditFree(compiledRE);
+	FreeRE(compiledRE);
 	return TRUE;
     }
 
-    NEditFree(compiledRE);
+    FreeRE(compiledRE);
     return FALSE;
 }
 
@@ -4577,14 +4577,14 @@ static int backwardRegexSearch(const char *string, const char *searchString, int
 		*searchExtentFW = compiledRE->extentpFW - string;
 	    if (searchExtentBW != NULL)
 		*searchExtentBW = compiledRE->extentpBW - string;
-	    NEditFree(compiledRE);
+	    FreeRE(compiledRE);
 	    return TRUE;
 	}
     }
     
     /* if wrap turned off, we're done */
     if (!wrap) {
-    	NEditFree(compiledRE);
+    	FreeRE(compiledRE);
     	return FALSE;
     }
     
@@ -4601,10 +4601,10 @@ static int backwardRegexSearch(const char *string, const char *searchString, int
 	    *searchExtentFW = compiledRE->extentpFW - string;
 	if (searchExtentBW != NULL)
 	    *searchExtentBW = compiledRE->extentpBW - string;
-	NEditFree(compiledRE);
+	FreeRE(compiledRE);
 	return TRUE;
     }
-    NEditFree(compiledRE);
+    FreeRE(compiledRE);
     return FALSE;
 }
 
@@ -4747,7 +4747,7 @@ static Boolean replaceUsingRE(const char* searchStr, const char* replaceStr,
     ExecRE(compiledRE, sourceStr+beginPos, NULL, False, prevChar, '\0',
             delimiters, sourceStr, NULL);
     substResult = SubstituteRE(compiledRE, replaceStr, destStr, maxDestLen);
-    NEditFree(compiledRE);
+    FreeRE(compiledRE);
 
     return substResult;
 }
@@ -399,20 +399,19 @@ static void getAnySelectionCB(Widget widget, XtPointer voidresult, Atom *sel,
 
 void SelectNumberedLine(WindowInfo *window, int lineNum)
 {
-    int i, lineStart = 0, lineEnd;
+    int lineStart, lineEnd;
 
-    /* count lines to find the start and end positions for the selection */
+    /* find the start and end positions for the selection (the buffer's
+       line index makes this quick, even far down a large file) */
     if (lineNum < 1)
     	lineNum = 1;
-    lineEnd = -1;
-    for (i=1; i<=lineNum && lineEnd<window->buffer->length; i++) {
-    	lineStart = lineEnd + 1;
-    	lineEnd = BufEndOfLine(window->buffer, lineStart);
-    }
     
     /* highlight the line */
-    if (i>lineNum) {
+    if (lineNum - 1 <= BufCountLines(window->buffer, 0,
+            window->buffer->length)) {
 	/* Line was found */
+	lineStart = BufCountForwardNLines(window->buffer, 0, lineNum - 1);
+	lineEnd = BufEndOfLine(window->buffer, lineStart);
 	if (lineEnd < window->buffer->length) {
 	    BufSelect(window->buffer, lineStart, lineEnd+1);
 	} else { 
@@ -32,6 +32,9 @@
 
 #include "textBuf.h"
 #include "rangeset.h"
+#include "pieceTable.h"
+#include "lineIndex.h"
+#include "textScan.h"
 #include "../util/nedit_malloc.h"
 
 #include <stdio.h>
@@ -46,6 +49,28 @@
 #define PREFERRED_GAP_SIZE 80	/* Initial size for the buffer gap (empty space
                                    in the buffer where text might be inserted
                                    if the user is typing sequential chars) */
+#define LINE_INDEX_MIN_LENGTH 262144 /* Buffers shorter than this are always
+                                   scanned for newlines rather than indexed */
+#define LINE_INDEX_MIN_SCAN 16384 /* Ranges shorter than this (and moves of
+                                   fewer lines than LINE_INDEX_MIN_LINES) are
+                                   counted faster by scanning than by looking
+                                   up the index */
+#define LINE_INDEX_MIN_LINES 64
+
+/* Text of a buffer frozen by BufCreateSnapshot: a piece table snapshot, or
+   for a gap buffer, a copy of the text */
+struct _bufSnapshot {
+    PieceSnapshot *pieces;
+    char *text;
+    int length;
+};
+
+/* Data for filterExternalText, the chunk filter of BufSetAllExternal */
+typedef struct {
+    bufFilterProc filterProc;	/* caller's filter, or NULL */
+    void *filterArg;
+    char nullSubsChar;		/* substitute for nulls, if the text has any */
+} externalFilter;
 
 static void histogramCharacters(const char *string, int length, char hist[256],
 	int init);
@@ -74,6 +99,20 @@ static void callModifyCBs(textBuffer *buf, int pos, int nDeleted,
 static void redisplaySelection(textBuffer *buf, selection *oldSelection,
 	selection *newSelection);
 static void moveGap(textBuffer *buf, int pos);
+static const char *bufSegment(const textBuffer *buf, int pos, int *segLen);
+static const char *bufSegmentBefore(const textBuffer *buf, int pos,
+	int *segLen);
+static void copyRange(const textBuffer *buf, int start, int end, char *outStr);
+static int filterExternalText(const char *text, int length, char *outText,
+        int *outLength, void *cbArg);
+static int countNewlines(const textBuffer *buf, int start, int end);
+static int lineIndexCountCB(void *countArg, int start, int end);
+static LineIndex *getLineIndex(textBuffer *buf);
+static int newlinesBefore(textBuffer *buf, LineIndex *index, int pos);
+static int lineStartOfNum(textBuffer *buf, LineIndex *index, int lineNum);
+static int scanForwardNLines(const textBuffer *buf, int startPos,
+	unsigned nLines);
+static void substituteBufChars(textBuffer *buf, char fromChar, char toChar);
 static void reallocateBuf(textBuffer *buf, int newGapStart, int newGapLen);
 static void setSelection(selection *sel, int start, int end);
 static void setRectSelect(selection *sel, int start, int end,
@@ -149,6 +188,8 @@ textBuffer *BufCreatePreallocated(int requestedSize)
     buf->buf[requestedSize + PREFERRED_GAP_SIZE] = '\0';
     buf->gapStart = 0;
     buf->gapEnd = PREFERRED_GAP_SIZE;
+    buf->pieces = NULL;
+    buf->lineIndex = NULL;
     buf->tabDist = 8;
     buf->useTabs = True;
     buf->primary.selected = False;
@@ -177,12 +218,45 @@ textBuffer *BufCreatePreallocated(int requestedSize)
     return buf;
 }
 
+/*
+** Create an empty text buffer holding its text in the storage engine given
+** by "storageType" (one of enum bufStorageTypes).  The default gap buffer
+** is fastest for editing in one place at a time.  The piece table keeps
+** the cost of edits at scattered positions, and of line counting,
+** logarithmic in the size of the text, and never needs a contiguous
+** allocation of the whole text (except when asked for by BufAsString).
+*/
+textBuffer *BufCreateWithStorage(int storageType)
+{
+    textBuffer *buf = BufCreatePreallocated(0);
+
+    if (storageType == BUF_STORAGE_PIECE_TABLE) {
+        NEditFree(buf->buf);
+        buf->buf = NULL;
+        buf->gapStart = buf->gapEnd = 0;
+        buf->pieces = PieceTableCreate();
+    }
+    return buf;
+}
+
+/*
+** Return the storage engine holding the text of "buf"
+*/
+int BufGetStorage(const textBuffer *buf)
+{
+    return buf->pieces != NULL ? BUF_STORAGE_PIECE_TABLE : BUF_STORAGE_GAP;
+}
+
 /*
 ** Free a text buffer
 */
 void BufFree(textBuffer *buf)
 {
     NEditFree(buf->buf);
+    if (buf->pieces != NULL)
+        PieceTableFree(buf->pieces);
+    if (buf->lineIndex != NULL)
+        LineIndexFree(buf->lineIndex);
     if (buf->nModifyProcs != 0) {
     	NEditFree(buf->modifyProcs);
     	NEditFree(buf->cbArgs);
@@ -205,9 +279,7 @@ char *BufGetAll(textBuffer *buf)
     char *text;
     
     text = (char*)NEditMalloc(buf->length+1);
-    memcpy(text, buf->buf, buf->gapStart);
-    memcpy(&text[buf->gapStart], &buf->buf[buf->gapEnd],
-            buf->length - buf->gapStart);
+    copyRange(buf, 0, buf->length, text);
     text[buf->length] = '\0';
     return text;
 }
@@ -219,7 +291,9 @@ char *BufGetAll(textBuffer *buf)
 ** NB DO NOT ALTER THE TEXT THROUGH THE RETURNED POINTER!
 ** (we make an exception in BufSubstituteNullChars() however)
 ** This function is intended ONLY to provide a searchable string without copying
-** into a temporary buffer.
+** into a temporary buffer.  (With piece table storage there is no single
+** block to return, so a contiguous copy is made and kept until the next
+** modification.)
 */
 const char *BufAsString(textBuffer *buf)
 {
@@ -228,6 +302,9 @@ const char *BufAsString(textBuffer *buf)
     int leftLen = buf->gapStart;
     int rightLen = bufLen - leftLen;
 
+    if (buf->pieces != NULL)
+        return PieceTableAsString(buf->pieces);
+
     /* find where best to put the gap to minimise memory movement */
     if (leftLen != 0 && rightLen != 0) {
         leftLen = (leftLen < rightLen) ? 0 : bufLen;
@@ -255,7 +332,19 @@ void BufSetAll(textBuffer *buf, const char *text)
     /* Save information for redisplay, and get rid of the old buffer */
     deletedText = BufGetAll(buf);
     deletedLength = buf->length;
+    if (buf->pieces != NULL) {
+        PieceTableSetAll(buf->pieces, text, length);
+        buf->length = length;
+        updateSelections(buf, 0, deletedLength, 0);
+        callModifyCBs(buf, 0, deletedLength, length, 0, deletedText);
+        NEditFree(deletedText);
+        return;
+    }
     NEditFree(buf->buf);
+    if (buf->lineIndex != NULL) {
+        LineIndexFree(buf->lineIndex);
+        buf->lineIndex = NULL;
+    }
     
     /* Start a new buffer with a gap of PREFERRED_GAP_SIZE in the center */
     buf->buf = (char*)NEditMalloc(length + PREFERRED_GAP_SIZE + 1);
@@ -277,6 +366,145 @@ void BufSetAll(textBuffer *buf, const char *text)
     NEditFree(deletedText);
 }
 
+/*
+** Replace the entire contents of the buffer with "length" characters of
+** "text" which the buffer goes on referring to rather than copying, as long
+** as they remain unmodified.  This is for loading (memory mapped) files
+** without the expense of a copy.  A gap buffer is switched to piece table
+** storage, which is what makes it possible.
+**
+** The text is examined in chunks, which "filterProc" (if not NULL) may
+** replace with converted text (see PieceTableSetExternal).  Nulls in the
+** text are substituted for as by BufSubstituteNullChars, chunk by chunk.
+** "releaseProc" is called once the buffer no longer refers to the text.
+**
+** Returns False, leaving the buffer unchanged, and without calling
+** releaseProc, if the text holds nulls and no substitute can be found.
+*/
+int BufSetAllExternal(textBuffer *buf, const char *text, int length,
+        bufFilterProc filterProc, void *filterArg,
+        bufReleaseProc releaseProc, void *releaseArg)
+{
+    externalFilter filter;
+    char histogram[256], *deletedText;
+    int deletedLength;
+
+    /* If the text has nulls, choose a stand-in which it doesn't contain */
+    filter.filterProc = filterProc;
+    filter.filterArg = filterArg;
+    filter.nullSubsChar = '\0';
+    if (length > 0 && memchr(text, '\0', length) != NULL) {
+        histogramCharacters(text, length, histogram, True);
+        filter.nullSubsChar = chooseNullSubsChar(histogram);
+        if (filter.nullSubsChar == '\0')
+            return False;
+    }
+
+    callPreDeleteCBs(buf, 0, buf->length);
+    deletedText = BufGetAll(buf);
+    deletedLength = buf->length;
+    if (buf->pieces == NULL) {
+        NEditFree(buf->buf);
+        buf->buf = NULL;
+        buf->gapStart = buf->gapEnd = 0;
+        if (buf->lineIndex != NULL) {
+            LineIndexFree(buf->lineIndex);
+            buf->lineIndex = NULL;
+        }
+        buf->pieces = PieceTableCreate();
+    }
+    PieceTableSetExternal(buf->pieces, text, length, filterExternalText,
+            &filter, releaseProc, releaseArg);
+    buf->length = PieceTableLength(buf->pieces);
+    if (filter.nullSubsChar != '\0')
+        buf->nullSubsChar = filter.nullSubsChar;
+    updateSelections(buf, 0, deletedLength, 0);
+    callModifyCBs(buf, 0, deletedLength, buf->length, 0, deletedText);
+    NEditFree(deletedText);
+    return True;
+}
+
+/*
+** Make the buffer take its own copy of any text it still refers to from
+** BufSetAllExternal, so the owner of the text is free to change it
+*/
+void BufCopyExternalText(textBuffer *buf)
+{
+    if (buf->pieces != NULL)
+        PieceTableCopyExternal(buf->pieces);
+}
+
+/*
+** Pass the text between "start" and "end" in "buf" to "segmentProc", in
+** order, as the runs in which it is stored, without copying it.  Stops and
+** returns False if "segmentProc" returns False, otherwise returns True.
+** The buffer must not be modified until it returns.
+*/
+int BufForEachSegment(const textBuffer *buf, int start, int end,
+        bufSegmentProc segmentProc, void *cbArg)
+{
+    const char *segment;
+    int pos, segLen;
+
+    if (start < 0)
+        start = 0;
+    if (end > buf->length)
+        end = buf->length;
+    for (pos = start; pos < end; pos += segLen) {
+        segment = bufSegment(buf, pos, &segLen);
+        if (segLen > end - pos)
+            segLen = end - pos;
+        if (!segmentProc(segment, segLen, cbArg))
+            return False;
+    }
+    return True;
+}
+
+/*
+** Record the text of "buf" as it is now, so that it can be read with
+** BufSnapshotForEachSegment, from any thread, while the buffer goes on
+** being modified.  A piece table buffer only needs to record its pieces
+** (see PieceTableSnapshot), a gap buffer is copied.  Free the snapshot with
+** BufFreeSnapshot on the thread which modifies the buffer.
+*/
+bufSnapshot *BufCreateSnapshot(textBuffer *buf)
+{
+    bufSnapshot *snapshot = NEditNew(bufSnapshot);
+
+    snapshot->length = buf->length;
+    if (buf->pieces != NULL) {
+        snapshot->pieces = PieceTableSnapshot(buf->pieces);
+        snapshot->text = NULL;
+    } else {
+        snapshot->pieces = NULL;
+        snapshot->text = (char *)NEditMalloc(buf->length + 1);
+        copyRange(buf, 0, buf->length, snapshot->text);
+    }
+    return snapshot;
+}
+
+/*
+** Pass the text of "snapshot" to "segmentProc" in order, in the runs in
+** which it is stored.  Stops and returns False if "segmentProc" returns
+** False, otherwise returns True.
+*/
+int BufSnapshotForEachSegment(const bufSnapshot *snapshot,
+        bufSegmentProc segmentProc, void *cbArg)
+{
+    if (snapshot->pieces != NULL)
+        return PieceSnapshotForEachPiece(snapshot->pieces, segmentProc, cbArg);
+    return snapshot->length == 0 ||
+            segmentProc(snapshot->text, snapshot->length, cbArg);
+}
+
+void BufFreeSnapshot(bufSnapshot *snapshot)
+{
+    if (snapshot->pieces != NULL)
+        PieceSnapshotFree(snapshot->pieces);
+    NEditFree(snapshot->text);
+    NEditFree(snapshot);
+}
+
 /*
 ** Return a copy of the text between "start" and "end" character positions
 ** from text buffer "buf".  Positions start at 0, and the range does not
@@ -285,7 +513,7 @@ void BufSetAll(textBuffer *buf, const char *text)
 char* BufGetRange(const textBuffer* buf, int start, int end)
 {
     char *text;
-    int length, part1Length;
+    int length;
     
     /* Make sure start and end are ok, and allocate memory for returned string.
        If start is bad, return "", if end is bad, adjust it. */
@@ -305,15 +533,7 @@ char* BufGetRange(const textBuffer* buf, int start, int end)
     text = (char*)NEditMalloc(length+1);
     
     /* Copy the text from the buffer to the returned string */
-    if (end <= buf->gapStart) {
-        memcpy(text, &buf->buf[start], length);
-    } else if (start >= buf->gapStart) {
-        memcpy(text, &buf->buf[start+(buf->gapEnd-buf->gapStart)], length);
-    } else {
-        part1Length = buf->gapStart - start;
-        memcpy(text, &buf->buf[start], part1Length);
-        memcpy(&text[part1Length], &buf->buf[buf->gapEnd], length-part1Length);
-    }
+    copyRange(buf, start, end, text);
     text[length] = '\0';
     return text;
 }
@@ -325,6 +545,8 @@ char BufGetCharacter(const textBuffer* buf, int pos)
 {
     if (pos < 0 || pos >= buf->length)
         return '\0';
+    if (buf->pieces != NULL)
+        return PieceTableGetChar(buf->pieces, pos);
     if (pos < buf->gapStart)
         return buf->buf[pos];
     else
@@ -399,6 +621,14 @@ void BufCopyFromBuf(textBuffer *fromBuf, textBuffer *toBuf, int fromStart,
     int length = fromEnd - fromStart;
     int part1Length;
 
+    /* The piece table has no gap to copy into, just go through a string */
+    if (fromBuf->pieces != NULL || toBuf->pieces != NULL) {
+        char *text = BufGetRange(fromBuf, fromStart, fromEnd);
+        insert(toBuf, toPos, text);
+        NEditFree(text);
+        return;
+    }
+
     /* Prepare the buffer to receive the new text.  If the new text fits in
        the current buffer, just move the gap (if necessary) to where
        the text should be inserted.  If the new text is too large, reallocate
@@ -424,6 +654,9 @@ void BufCopyFromBuf(textBuffer *fromBuf, textBuffer *toBuf, int fromStart,
     }
     toBuf->gapStart += length;
     toBuf->length += length;
+    if (toBuf->lineIndex != NULL)
+        LineIndexInsert(toBuf->lineIndex, toPos, length,
+                countNewlines(toBuf, toPos, toPos + length));
     updateSelections(toBuf, toPos, 0, length);
 } 
 
@@ -1146,23 +1379,18 @@ int BufCountForwardDispChars(textBuffer *buf, int lineStartPos, int nChars)
 */
 int BufCountLines(textBuffer *buf, int startPos, int endPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    int lineCount = 0;
+    LineIndex *index;
     
-    pos = startPos;
-    while (pos < buf->gapStart) {
-        if (pos == endPos)
-            return lineCount;
-        if (buf->buf[pos++] == '\n')
-            lineCount++;
-    }
-    while (pos < buf->length) {
-        if (pos == endPos)
-            return lineCount;
-    	if (buf->buf[pos++ + gapLen] == '\n')
-            lineCount++;
-    }
-    return lineCount;
+    if (endPos < startPos || endPos > buf->length)
+        endPos = buf->length;
+    if (buf->pieces != NULL)
+        return PieceTableCountNewlines(buf->pieces, endPos) -
+                PieceTableCountNewlines(buf->pieces, startPos);
+    if (endPos - startPos >= LINE_INDEX_MIN_SCAN &&
+            (index = getLineIndex(buf)) != NULL)
+        return newlinesBefore(buf, index, endPos) -
+                newlinesBefore(buf, index, startPos);
+    return countNewlines(buf, startPos, endPos);
 }
 
 /*
@@ -1172,28 +1400,24 @@ int BufCountLines(textBuffer *buf, int startPos, int endPos)
 int BufCountForwardNLines(const textBuffer* buf, int startPos,
         unsigned nLines)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    int lineCount = 0;
+    LineIndex *index;
     
     if (nLines == 0)
     	return startPos;
+    if (buf->pieces != NULL)
+        return PieceTableLineStart(buf->pieces,
+                PieceTableCountNewlines(buf->pieces, startPos) + nLines);
     
-    pos = startPos;
-    while (pos < buf->gapStart) {
-        if (buf->buf[pos++] == '\n') {
-            lineCount++;
-            if (lineCount == nLines)
-            	return pos;
-        }
+    /* the line index is only a cache, so is built even for a const buffer */
+    if (nLines >= LINE_INDEX_MIN_LINES &&
+            (index = getLineIndex((textBuffer *)buf)) != NULL) {
+        if (nLines > (unsigned)(LineIndexTotalNewlines(index) -
+                newlinesBefore((textBuffer *)buf, index, startPos)))
+            return buf->length;
+        return lineStartOfNum((textBuffer *)buf, index,
+                newlinesBefore((textBuffer *)buf, index, startPos) + nLines);
     }
-    while (pos < buf->length) {
-    	if (buf->buf[pos++ + gapLen] == '\n') {
-            lineCount++;
-            if (lineCount >= nLines)
-            	return pos;
-        }
-    }
-    return pos;
+    return scanForwardNLines(buf, startPos, nLines);
 }
 
 /*
@@ -1204,26 +1428,34 @@ int BufCountForwardNLines(const textBuffer* buf, int startPos,
 */
 int BufCountBackwardNLines(textBuffer *buf, int startPos, int nLines)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
+    int pos, segLen, lineNum;
     int lineCount = -1;
+    const char *text, *c;
+    LineIndex *index;
     
     pos = startPos - 1;
     if (pos <= 0)
     	return 0;
-    
-    while (pos >= buf->gapStart) {
-    	if (buf->buf[pos + gapLen] == '\n') {
-            if (++lineCount >= nLines)
-            	return pos + 1;
-        }
-        pos--;
-    }
-    while (pos >= 0) {
-        if (buf->buf[pos] == '\n') {
+    if (pos >= buf->length)
+        pos = buf->length - 1;
+    if (buf->pieces != NULL) {
+        lineNum = PieceTableCountNewlines(buf->pieces, pos + 1) - nLines;
+        return lineNum <= 0 ? 0 : PieceTableLineStart(buf->pieces, lineNum);
+    }
+    if (nLines >= LINE_INDEX_MIN_LINES && (index = getLineIndex(buf)) != NULL) {
+        lineNum = newlinesBefore(buf, index, pos + 1) - nLines;
+        return lineNum <= 0 ? 0 : lineStartOfNum(buf, index, lineNum);
+    }
+    
+    /* scan backward from pos, including the character at pos itself */
+    pos++;
+    while ((text = bufSegmentBefore(buf, pos, &segLen)) != NULL) {
+        for (c = text + segLen;
+                (c = ScanFindCharBackward(text, c - text, '\n')) != NULL; ) {
             if (++lineCount >= nLines)
-            	return pos + 1;
+                return pos - segLen + (c - text) + 1;
         }
-        pos--;
+        pos -= segLen;
     }
     return 0;
 }
@@ -1236,27 +1468,16 @@ int BufCountBackwardNLines(textBuffer *buf, int startPos, int nLines)
 int BufSearchForward(textBuffer *buf, int startPos, const char *searchChars,
 	int *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    const char *c;
+    int pos, segLen;
+    const char *text, *t;
     
     pos = startPos;
-    while (pos < buf->gapStart) {
-        for (c=searchChars; *c!='\0'; c++) {
-	    if (buf->buf[pos] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
-        }
-        pos++;
-    }
-    while (pos < buf->length) {
-    	for (c=searchChars; *c!='\0'; c++) {
-    	    if (buf->buf[pos + gapLen] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
+    while ((text = bufSegment(buf, pos, &segLen)) != NULL) {
+        if ((t = ScanFindAnyChar(text, segLen, searchChars)) != NULL) {
+            *foundPos = pos + (t - text);
+            return True;
         }
-        pos++;
+        pos += segLen;
     }
     *foundPos = buf->length;
     return False;
@@ -1270,31 +1491,16 @@ int BufSearchForward(textBuffer *buf, int startPos, const char *searchChars,
 int BufSearchBackward(textBuffer *buf, int startPos, const char *searchChars,
 	int *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    const char *c;
+    int pos, segLen;
+    const char *text, *t;
     
-    if (startPos == 0) {
-    	*foundPos = 0;
-    	return False;
-    }
-    pos = startPos == 0 ? 0 : startPos - 1;
-    while (pos >= buf->gapStart) {
-    	for (c=searchChars; *c!='\0'; c++) {
-    	    if (buf->buf[pos + gapLen] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
-        }
-        pos--;
-    }
-    while (pos >= 0) {
-    	for (c=searchChars; *c!='\0'; c++) {
-            if (buf->buf[pos] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
+    pos = startPos > buf->length ? buf->length : startPos;
+    while ((text = bufSegmentBefore(buf, pos, &segLen)) != NULL) {
+        if ((t = ScanFindAnyCharBackward(text, segLen, searchChars)) != NULL) {
+            *foundPos = pos - segLen + (t - text);
+            return True;
         }
-        pos--;
+        pos -= segLen;
     }
     *foundPos = 0;
     return False;
@@ -1332,17 +1538,17 @@ int BufSubstituteNullChars(char *string, int length, textBuffer *buf)
        string and the buffer, and change the buffer's null-substitution
        character.  If none can be found, give up and return False */
     if (histogram[(unsigned char)buf->nullSubsChar] != 0) {
-        char *bufString, newSubsChar;
-        /* here we know we can modify the file buffer directly,
-           so we cast away constness */
-        bufString = (char *)BufAsString(buf);
-        histogramCharacters(bufString, buf->length, histogram, False);
+        const char *segment;
+        char newSubsChar;
+        int pos, segLen;
+        for (pos = 0; (segment = bufSegment(buf, pos, &segLen)) != NULL;
+                pos += segLen)
+            histogramCharacters(segment, segLen, histogram, False);
         newSubsChar = chooseNullSubsChar(histogram);
         if (newSubsChar == '\0') {
             return False;
         }
-        /* bufString points to the buffer's data, so we substitute in situ */
-        subsChars(bufString, buf->length, buf->nullSubsChar, newSubsChar);
+        substituteBufChars(buf, buf->nullSubsChar, newSubsChar);
         buf->nullSubsChar = newSubsChar;
     }
 
@@ -1379,8 +1585,9 @@ void BufUnsubstituteNullChars(char *string, textBuffer *buf)
 int BufCmp(textBuffer * buf, int pos, int len, const char *cmpText)
 {
     int     posEnd;
-    int     part1Length;
+    int     segLen;
     int     result;
+    const char *text;
 
     posEnd = pos + len;
     if (posEnd > buf->length) {
@@ -1390,20 +1597,17 @@ int BufCmp(textBuffer * buf, int pos, int len, const char *cmpText)
         return (-1);
     }
 
-    if (posEnd <= buf->gapStart) {
-        return (strncmp(&(buf->buf[pos]), cmpText, len));
-    } else if (pos >= buf->gapStart) {
-        return (strncmp (&buf->buf[pos + (buf->gapEnd - buf->gapStart)], 
-	    	    	cmpText, len));
-    } else {
-        part1Length = buf->gapStart - pos;
-        result = strncmp(&buf->buf[pos], cmpText, part1Length);
+    while (pos < posEnd && (text = bufSegment(buf, pos, &segLen)) != NULL) {
+        if (segLen > posEnd - pos)
+            segLen = posEnd - pos;
+        result = strncmp(text, cmpText, segLen);
         if (result) {
             return (result);
-	}
-        return (strncmp(&buf->buf[buf->gapEnd], &cmpText[part1Length], 
-	    	    	len - part1Length));
+        }
+        cmpText += segLen;
+        pos += segLen;
     }
+    return 0;
 }
 
 /*
@@ -1416,13 +1620,11 @@ static void histogramCharacters(const char *string, int length, char hist[256],
 	int init)
 {
     int i;
-    const char *c;
 
     if (init)
 	for (i=0; i<256; i++)
 	    hist[i] = 0;
-    for (c=string; c < &string[length]; c++)
-        hist[*((unsigned char *)c)] |= 1;
+    ScanMarkChars(string, length, hist);
 }
 
 /*
@@ -1465,6 +1667,16 @@ static int insert(textBuffer *buf, int pos, const char *text)
 {
     int length = strlen(text);
 
+    if (buf->pieces != NULL) {
+        PieceTableInsert(buf->pieces, pos, text, length);
+        buf->length += length;
+        updateSelections(buf, pos, 0, length);
+        return length;
+    }
+    if (buf->lineIndex != NULL)
+        LineIndexInsert(buf->lineIndex, pos, length,
+                ScanCountChar(text, length, '\n'));
+
     /* Prepare the buffer to receive the new text.  If the new text fits in
        the current buffer, just move the gap (if necessary) to where
        the text should be inserted.  If the new text is too large, reallocate
@@ -1491,6 +1703,17 @@ static int insert(textBuffer *buf, int pos, const char *text)
 */
 static void delete(textBuffer *buf, int start, int end)
 {
+    if (buf->pieces != NULL) {
+        PieceTableDelete(buf->pieces, start, end);
+        buf->length -= end - start;
+        updateSelections(buf, start, end-start, 0);
+        return;
+    }
+    
+    /* the line index needs to see the text before it goes */
+    if (buf->lineIndex != NULL)
+        LineIndexDelete(buf->lineIndex, start, end);
+
     /* if the gap is not contiguous to the area to remove, move it there */
     if (start > buf->gapStart)
     	moveGap(buf, start);
@@ -2199,6 +2422,193 @@ static void moveGap(textBuffer *buf, int pos)
     buf->gapStart += pos - buf->gapStart;
 }
 
+/*
+** Return a pointer to the longest run of contiguous text in "buf" beginning
+** at position "pos", and its length in "segLen" (NULL at the end of the
+** buffer).  This, and bufSegmentBefore below, let scanning code work on
+** either storage engine without caring where the gap or piece boundaries are.
+*/
+static const char *bufSegment(const textBuffer *buf, int pos, int *segLen)
+{
+    if (buf->pieces != NULL)
+        return PieceTableSegment(buf->pieces, pos, segLen);
+    if (pos < 0 || pos >= buf->length) {
+        *segLen = 0;
+        return NULL;
+    }
+    if (pos < buf->gapStart) {
+        *segLen = buf->gapStart - pos;
+        return &buf->buf[pos];
+    }
+    *segLen = buf->length - pos;
+    return &buf->buf[pos + buf->gapEnd - buf->gapStart];
+}
+
+/*
+** Return a pointer to the start of the longest run of contiguous text in
+** "buf" ending just before position "pos", and its length in "segLen" (NULL
+** at the start of the buffer).
+*/
+static const char *bufSegmentBefore(const textBuffer *buf, int pos,
+	int *segLen)
+{
+    if (buf->pieces != NULL)
+        return PieceTableSegmentBefore(buf->pieces, pos, segLen);
+    if (pos <= 0 || pos > buf->length) {
+        *segLen = 0;
+        return NULL;
+    }
+    if (pos <= buf->gapStart) {
+        *segLen = pos;
+        return buf->buf;
+    }
+    *segLen = pos - buf->gapStart;
+    return &buf->buf[buf->gapEnd];
+}
+
+/*
+** Copy the text between "start" and "end" (which must be valid positions in
+** "buf") to "outStr".  No terminating null is added.
+*/
+static void copyRange(const textBuffer *buf, int start, int end, char *outStr)
+{
+    int part1Length, length = end - start;
+
+    if (buf->pieces != NULL) {
+        PieceTableCopyRange(buf->pieces, start, end, outStr);
+    } else if (end <= buf->gapStart) {
+        memcpy(outStr, &buf->buf[start], length);
+    } else if (start >= buf->gapStart) {
+        memcpy(outStr, &buf->buf[start+(buf->gapEnd-buf->gapStart)], length);
+    } else {
+        part1Length = buf->gapStart - start;
+        memcpy(outStr, &buf->buf[start], part1Length);
+        memcpy(&outStr[part1Length], &buf->buf[buf->gapEnd],
+                length-part1Length);
+    }
+}
+
+/*
+** Count the newlines between "start" and "end" in "buf" by scanning the text
+*/
+static int countNewlines(const textBuffer *buf, int start, int end)
+{
+    int pos, segLen, lineCount = 0;
+    const char *text;
+
+    pos = start;
+    while (pos < end && (text = bufSegment(buf, pos, &segLen)) != NULL) {
+        if (segLen > end - pos)
+            segLen = end - pos;
+        lineCount += ScanCountChar(text, segLen, '\n');
+        pos += segLen;
+    }
+    return lineCount;
+}
+
+/*
+** Find the start of the line "nLines" forward from "startPos" by scanning
+** the text (see BufCountForwardNLines)
+*/
+static int scanForwardNLines(const textBuffer *buf, int startPos,
+	unsigned nLines)
+{
+    int pos, segLen, nFound;
+    const char *text, *c;
+
+    pos = startPos;
+    while ((text = bufSegment(buf, pos, &segLen)) != NULL) {
+        if ((c = ScanFindNthChar(text, segLen, '\n', nLines, &nFound)) != NULL)
+            return pos + (c - text) + 1;
+        nLines -= nFound;
+        pos += segLen;
+    }
+    return buf->length;
+}
+
+/*
+** Chunk filter for BufSetAllExternal: apply the caller's filter, then
+** substitute for any nulls
+*/
+static int filterExternalText(const char *text, int length, char *outText,
+        int *outLength, void *cbArg)
+{
+    externalFilter *filter = (externalFilter *)cbArg;
+    int filtered = False;
+
+    if (filter->filterProc != NULL)
+        filtered = filter->filterProc(text, length, outText, outLength,
+                filter->filterArg);
+    if (filter->nullSubsChar == '\0')
+        return filtered;
+    if (!filtered) {
+        if (memchr(text, '\0', length) == NULL)
+            return False;
+        memcpy(outText, text, length);
+        *outLength = length;
+    }
+    subsChars(outText, *outLength, '\0', filter->nullSubsChar);
+    return True;
+}
+
+static int lineIndexCountCB(void *countArg, int start, int end)
+{
+    return countNewlines((textBuffer *)countArg, start, end);
+}
+
+/*
+** Return the line index of a gap buffer, creating it if the buffer has
+** grown large enough to be worth indexing, or NULL if it hasn't.  Once made,
+** the index is kept up to date by insert and delete, and is only discarded
+** when the whole text is replaced.
+*/
+static LineIndex *getLineIndex(textBuffer *buf)
+{
+    if (buf->lineIndex == NULL && buf->length >= LINE_INDEX_MIN_LENGTH)
+        buf->lineIndex = LineIndexCreate(buf->length, lineIndexCountCB, buf);
+    return buf->lineIndex;
+}
+
+/*
+** Return the number of newlines in "buf" before position "pos", using "index"
+*/
+static int newlinesBefore(textBuffer *buf, LineIndex *index, int pos)
+{
+    int chunkStart, nNewlines;
+
+    nNewlines = LineIndexNewlinesBefore(index, pos, &chunkStart);
+    return nNewlines + countNewlines(buf, chunkStart, pos);
+}
+
+/*
+** Return the position just after newline number "lineNum" (counting from 1)
+** in "buf", i.e. the start of line lineNum+1, using "index"
+*/
+static int lineStartOfNum(textBuffer *buf, LineIndex *index, int lineNum)
+{
+    int chunkStart, nRemaining;
+
+    if (lineNum > LineIndexTotalNewlines(index))
+        return buf->length;
+    chunkStart = LineIndexFindNewline(index, lineNum, &nRemaining);
+    return scanForwardNLines(buf, chunkStart, nRemaining);
+}
+
+/*
+** Substitute fromChar with toChar in the text of "buf", in place and without
+** calling any callbacks (used only for changing the null substitution char)
+*/
+static void substituteBufChars(textBuffer *buf, char fromChar, char toChar)
+{
+    if (buf->pieces != NULL) {
+        PieceTableSubstituteChar(buf->pieces, fromChar, toChar);
+        return;
+    }
+    subsChars(buf->buf, buf->gapStart, fromChar, toChar);
+    subsChars(&buf->buf[buf->gapEnd], buf->length - buf->gapStart, fromChar,
+            toChar);
+}
+
 /*
 ** reallocate the text storage in "buf" to have a gap starting at "newGapStart"
 ** and a gap size of "newGapLen", preserving the buffer's current contents.
@@ -2282,22 +2692,16 @@ static void updateSelection(selection *sel, int pos, int nDeleted,
 static int searchForward(textBuffer *buf, int startPos, char searchChar,
 	int *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
+    int pos, segLen;
+    const char *text, *c;
     
     pos = startPos;
-    while (pos < buf->gapStart) {
-        if (buf->buf[pos] == searchChar) {
-            *foundPos = pos;
-            return True;
-        }
-        pos++;
-    }
-    while (pos < buf->length) {
-    	if (buf->buf[pos + gapLen] == searchChar) {
-            *foundPos = pos;
+    while ((text = bufSegment(buf, pos, &segLen)) != NULL) {
+        if ((c = ScanFindChar(text, segLen, searchChar)) != NULL) {
+            *foundPos = pos + (c - text);
             return True;
         }
-        pos++;
+        pos += segLen;
     }
     *foundPos = buf->length;
     return False;
@@ -2314,26 +2718,16 @@ static int searchForward(textBuffer *buf, int startPos, char searchChar,
 static int searchBackward(textBuffer *buf, int startPos, char searchChar,
 	int *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
+    int pos, segLen;
+    const char *text, *c;
     
-    if (startPos == 0) {
-    	*foundPos = 0;
-    	return False;
-    }
-    pos = startPos == 0 ? 0 : startPos - 1;
-    while (pos >= buf->gapStart) {
-    	if (buf->buf[pos + gapLen] == searchChar) {
-            *foundPos = pos;
+    pos = startPos > buf->length ? buf->length : startPos;
+    while ((text = bufSegmentBefore(buf, pos, &segLen)) != NULL) {
+        if ((c = ScanFindCharBackward(text, segLen, searchChar)) != NULL) {
+            *foundPos = pos - segLen + (c - text);
             return True;
         }
-        pos--;
-    }
-    while (pos >= 0) {
-        if (buf->buf[pos] == searchChar) {
-            *foundPos = pos;
-            return True;
-        }
-        pos--;
+        pos -= segLen;
     }
     *foundPos = 0;
     return False;
@@ -2364,12 +2758,7 @@ static char *copyLine(const char *text, int *lineLen)
 */
 static int countLines(const char *string)
 {
-    const char *c;
-    int lineCount = 0;
-    
-    for (c=string; *c!='\0'; c++)
-    	if (*c == '\n') lineCount++;
-    return lineCount;
+    return ScanCountChar(string, strlen(string), '\n');
 }
 
 /*
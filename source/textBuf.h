@@ -32,6 +32,12 @@
 #define MAX_EXP_CHAR_LEN 20
 
 typedef struct _RangesetTable RangesetTable;
+typedef struct _bufSnapshot bufSnapshot;
+
+/* Storage engines for the text of a buffer (see BufCreateWithStorage).
+   This enum must be kept in parallel to the array BufferStorageModes[]
+   in preferences.c */
+enum bufStorageTypes {BUF_STORAGE_GAP, BUF_STORAGE_PIECE_TABLE};
 
 typedef struct {
     char selected;          /* True if the selection is active */
@@ -50,6 +56,10 @@ typedef struct {
 typedef void (*bufModifyCallbackProc)(int pos, int nInserted, int nDeleted,
 	int nRestyled, const char *deletedText, void *cbArg);
 typedef void (*bufPreDeleteCallbackProc)(int pos, int nDeleted, void *cbArg);
+typedef int (*bufFilterProc)(const char *text, int length, char *outText,
+        int *outLength, void *cbArg);
+typedef void (*bufReleaseProc)(void *cbArg);
+typedef int (*bufSegmentProc)(const char *text, int length, void *cbArg);
 
 typedef struct _textBuffer {
     int length; 	        /* length of the text in the buffer (the length
@@ -58,6 +68,12 @@ typedef struct _textBuffer {
     char *buf;                  /* allocated memory where the text is stored */
     int gapStart;  	        /* points to the first character of the gap */
     int gapEnd;                 /* points to the first char after the gap */
+    struct _PieceTable *pieces; /* text storage used in place of the gap
+                                   buffer above when the buffer was created
+                                   with BUF_STORAGE_PIECE_TABLE, else NULL */
+    struct _LineIndex *lineIndex; /* newline counts for fast line number
+                                   lookups in large gap buffers, built on
+                                   first need (NULL until then) */
     selection primary;		/* highlighted areas */
     selection secondary;
     selection highlight;
@@ -85,11 +101,23 @@ typedef struct _textBuffer {
 
 textBuffer *BufCreate(void);
 textBuffer *BufCreatePreallocated(int requestedSize);
+textBuffer *BufCreateWithStorage(int storageType);
+int BufGetStorage(const textBuffer *buf);
 void BufFree(textBuffer *buf);
 char *BufGetAll(textBuffer *buf);
 const char *BufAsString(textBuffer *buf);
 void BufSetAll(textBuffer *buf, const char *text);
+int BufSetAllExternal(textBuffer *buf, const char *text, int length,
+        bufFilterProc filterProc, void *filterArg,
+        bufReleaseProc releaseProc, void *releaseArg);
+void BufCopyExternalText(textBuffer *buf);
 char* BufGetRange(const textBuffer* buf, int start, int end);
+int BufForEachSegment(const textBuffer *buf, int start, int end,
+        bufSegmentProc segmentProc, void *cbArg);
+bufSnapshot *BufCreateSnapshot(textBuffer *buf);
+int BufSnapshotForEachSegment(const bufSnapshot *snapshot,
+        bufSegmentProc segmentProc, void *cbArg);
+void BufFreeSnapshot(bufSnapshot *snapshot);
 char BufGetCharacter(const textBuffer* buf, int pos);
 char *BufGetTextInRect(textBuffer *buf, int start, int end,
 	int rectStart, int rectEnd);
@@ -958,19 +958,16 @@ int TextDLineAndColToPos(textDisp *textD, int lineNum, int column)
     int lineStart=0, charLen=0;
     char *lineStr, expandedChar[MAX_EXP_CHAR_LEN];
 
-    /* Count lines */
+    /* Find the line (BufCountForwardNLines uses the buffer's line index
+       for large buffers, so this doesn't have to scan the whole file) */
     if (lineNum < 1)
         lineNum = 1;
-    lineEnd = -1;
-    for (i=1; i<=lineNum && lineEnd<textD->buffer->length; i++) {
-        lineStart = lineEnd + 1;
-        lineEnd = BufEndOfLine(textD->buffer, lineStart);
-    }
 
     /* If line is beyond end of buffer, position at last character in buffer */
-    if ( lineNum >= i ) {
-      return lineEnd;
-    }
+    if (lineNum - 1 > BufCountLines(textD->buffer, 0, textD->buffer->length))
+        return textD->buffer->length;
+    lineStart = BufCountForwardNLines(textD->buffer, 0, lineNum - 1);
+    lineEnd = BufEndOfLine(textD->buffer, lineStart);
 
     /* Start character index at zero */
     charIndex=0;
@@ -0,0 +1,605 @@
+/*******************************************************************************
+*                                                                              *
+* textScan.c -- Vectorized character scanning kernels for the text buffer      *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute version of this program linked to   *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License        *
+* for more details.                                                            *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** The inner loops of the text buffer: finding and counting characters (most
+** often newlines) in a contiguous run of text.  The callers in textBuf.c
+** split the buffer into contiguous segments around the gap (or the pieces of
+** a piece table) and hand each one to these routines.
+**
+** There are three sets of kernels: a portable one in plain C, and SSE2 and
+** AVX2 ones for x86 processors, which compare 16 or 32 characters at a time.
+** The best set the processor supports is picked on first use.  The AVX2 code
+** is compiled with a per-function target attribute, so the rest of NEdit
+** doesn't need to be built for AVX2 capable machines only.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "textScan.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || \
+        (defined(__i386__) && defined(__SSE2__)))
+#define SCAN_SSE2
+#include <emmintrin.h>
+#if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define SCAN_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef HAVE_DEBUG_H
+#include "../debug.h"
+#endif
+
+/* Longest set of characters for which ScanFindAnyChar compares each block of
+   text against every member; larger sets are looked up in a table */
+#define MAX_VECTOR_CHARS 8
+
+/* Length of text over which ScanFindNthChar counts before it looks */
+#define NTH_CHAR_BLOCK 1024
+
+typedef struct {
+    const char *name;
+    int (*countChar)(const char *text, int length, char c);
+    const char *(*findChar)(const char *text, int length, char c);
+    const char *(*findCharBackward)(const char *text, int length, char c);
+    const char *(*findAnyChar)(const char *text, int length,
+            const char *chars, int nChars);
+    const char *(*findAnyCharBackward)(const char *text, int length,
+            const char *chars, int nChars);
+} scanKernels;
+
+static void selectBestKernels(void);
+static const char *findAnyCharTable(const char *text, int length,
+        const char *chars, int backward);
+static int countCharPortable(const char *text, int length, char c);
+static const char *findCharPortable(const char *text, int length, char c);
+static const char *findCharBackwardPortable(const char *text, int length,
+        char c);
+static const char *findAnyCharPortable(const char *text, int length,
+        const char *chars, int nChars);
+static const char *findAnyCharBackwardPortable(const char *text, int length,
+        const char *chars, int nChars);
+#ifdef SCAN_SSE2
+static int countCharSSE2(const char *text, int length, char c);
+static const char *findCharSSE2(const char *text, int length, char c);
+static const char *findCharBackwardSSE2(const char *text, int length, char c);
+static const char *findAnyCharSSE2(const char *text, int length,
+        const char *chars, int nChars);
+static const char *findAnyCharBackwardSSE2(const char *text, int length,
+        const char *chars, int nChars);
+#endif
+#ifdef SCAN_AVX2
+static int countCharAVX2(const char *text, int length, char c);
+static const char *findCharAVX2(const char *text, int length, char c);
+static const char *findCharBackwardAVX2(const char *text, int length, char c);
+static const char *findAnyCharAVX2(const char *text, int length,
+        const char *chars, int nChars);
+static const char *findAnyCharBackwardAVX2(const char *text, int length,
+        const char *chars, int nChars);
+#endif
+
+static const scanKernels KernelSets[N_SCAN_KERNEL_TYPES] = {
+    {"portable", countCharPortable, findCharPortable,
+            findCharBackwardPortable, findAnyCharPortable,
+            findAnyCharBackwardPortable},
+#ifdef SCAN_SSE2
+    {"sse2", countCharSSE2, findCharSSE2, findCharBackwardSSE2,
+            findAnyCharSSE2, findAnyCharBackwardSSE2},
+#else
+    {NULL},
+#endif
+#ifdef SCAN_AVX2
+    {"avx2", countCharAVX2, findCharAVX2, findCharBackwardAVX2,
+            findAnyCharAVX2, findAnyCharBackwardAVX2}
+#else
+    {NULL}
+#endif
+};
+
+static const scanKernels *Kernels = NULL;
+
+/*
+** Return the number of occurrences of "c" in the "length" characters of
+** "text"
+*/
+int ScanCountChar(const char *text, int length, char c)
+{
+    if (Kernels == NULL)
+        selectBestKernels();
+    return Kernels->countChar(text, length, c);
+}
+
+/*
+** Return a pointer to the first occurrence of "c" in the "length"
+** characters of "text", or NULL if there is none
+*/
+const char *ScanFindChar(const char *text, int length, char c)
+{
+    if (Kernels == NULL)
+        selectBestKernels();
+    return Kernels->findChar(text, length, c);
+}
+
+/*
+** Return a pointer to the last occurrence of "c" in the "length" characters
+** of "text", or NULL if there is none
+*/
+const char *ScanFindCharBackward(const char *text, int length, char c)
+{
+    if (Kernels == NULL)
+        selectBestKernels();
+    return Kernels->findCharBackward(text, length, c);
+}
+
+/*
+** Return a pointer to the "n"th occurrence (counting from 1) of "c" in the
+** "length" characters of "text".  If there are fewer than n, returns NULL,
+** and how many there were in "nFound".
+*/
+const char *ScanFindNthChar(const char *text, int length, char c, int n,
+        int *nFound)
+{
+    const char *t = text, *end = text + length, *found;
+    int blockCount, count = 0;
+
+    if (Kernels == NULL)
+        selectBestKernels();
+
+    /* skip whole blocks while they don't hold enough occurrences, counting
+       being much faster than finding them one at a time */
+    while (n - count > 1 && end - t > NTH_CHAR_BLOCK) {
+        blockCount = Kernels->countChar(t, NTH_CHAR_BLOCK, c);
+        if (count + blockCount >= n)
+            break;
+        count += blockCount;
+        t += NTH_CHAR_BLOCK;
+    }
+    while ((found = Kernels->findChar(t, end - t, c)) != NULL) {
+        if (++count == n)
+            return found;
+        t = found + 1;
+    }
+    *nFound = count;
+    return NULL;
+}
+
+/*
+** Return a pointer to the first character in the "length" characters of
+** "text" which is one of the (null terminated) string "chars", or NULL if
+** none of them occur.
+*/
+const char *ScanFindAnyChar(const char *text, int length, const char *chars)
+{
+    int nChars = strlen(chars);
+
+    if (Kernels == NULL)
+        selectBestKernels();
+    if (nChars > MAX_VECTOR_CHARS)
+        return findAnyCharTable(text, length, chars, 0);
+    return Kernels->findAnyChar(text, length, chars, nChars);
+}
+
+/*
+** Return a pointer to the last character in the "length" characters of
+** "text" which is one of "chars", or NULL if none of them occur.
+*/
+const char *ScanFindAnyCharBackward(const char *text, int length,
+        const char *chars)
+{
+    int nChars = strlen(chars);
+
+    if (Kernels == NULL)
+        selectBestKernels();
+    if (nChars > MAX_VECTOR_CHARS)
+        return findAnyCharTable(text, length, chars, 1);
+    return Kernels->findAnyCharBackward(text, length, chars, nChars);
+}
+
+/*
+** Mark the characters which occur in the "length" characters of "text" by
+** setting their entries in "present" to 1 (existing marks are left alone).
+** This is a table lookup per character which no vector instruction set here
+** can do better, but spreading the stores over four tables lets the stores
+** of successive characters proceed independently.
+*/
+void ScanMarkChars(const char *text, int length, char present[256])
+{
+    const unsigned char *t = (const unsigned char *)text;
+    const unsigned char *end = t + length;
+    char marks[4][256];
+    int i;
+
+    if (length < 256) {
+        for (; t < end; t++)
+            present[*t] = 1;
+        return;
+    }
+    memset(marks, 0, sizeof(marks));
+    for (; end - t >= 4; t += 4) {
+        marks[0][t[0]] = 1;
+        marks[1][t[1]] = 1;
+        marks[2][t[2]] = 1;
+        marks[3][t[3]] = 1;
+    }
+    for (; t < end; t++)
+        marks[0][*t] = 1;
+    for (i = 0; i < 256; i++)
+        present[i] |= marks[0][i] | marks[1][i] | marks[2][i] | marks[3][i];
+}
+
+/*
+** Switch the scanning routines to the set of kernels "type" (from enum
+** scanKernelTypes), for comparing implementations.  If the processor can't
+** run that set, the best one it can is used instead.  Returns the type
+** actually selected.
+*/
+int ScanSelectKernels(int type)
+{
+    selectBestKernels();
+    if (type >= 0 && type < N_SCAN_KERNEL_TYPES &&
+            type <= Kernels - KernelSets && KernelSets[type].name != NULL)
+        Kernels = &KernelSets[type];
+    return Kernels - KernelSets;
+}
+
+/*
+** Return the name of the set of kernels "type", or NULL if this build
+** doesn't include it
+*/
+const char *ScanKernelsName(int type)
+{
+    if (type < 0 || type >= N_SCAN_KERNEL_TYPES)
+        return NULL;
+    return KernelSets[type].name;
+}
+
+static void selectBestKernels(void)
+{
+    const scanKernels *best = &KernelSets[SCAN_KERNELS_PORTABLE];
+
+#ifdef SCAN_SSE2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        best = &KernelSets[SCAN_KERNELS_SSE2];
+#ifdef SCAN_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        best = &KernelSets[SCAN_KERNELS_AVX2];
+#endif
+#endif
+    Kernels = best;
+}
+
+/*
+** Find the first (or if "backward" is true, the last) character of text
+** appearing in "chars", by table lookup
+*/
+static const char *findAnyCharTable(const char *text, int length,
+        const char *chars, int backward)
+{
+    char inSet[256];
+    const unsigned char *c;
+
+    memset(inSet, 0, sizeof(inSet));
+    for (c = (const unsigned char *)chars; *c != '\0'; c++)
+        inSet[*c] = 1;
+    if (backward) {
+        for (c = (const unsigned char *)text + length - 1;
+                c >= (const unsigned char *)text; c--)
+            if (inSet[*c])
+                return (const char *)c;
+    } else {
+        for (c = (const unsigned char *)text;
+                c < (const unsigned char *)text + length; c++)
+            if (inSet[*c])
+                return (const char *)c;
+    }
+    return NULL;
+}
+
+/*
+** Portable kernels.  memchr is usually well optimized by the C library, and
+** the simple counting loop is one compilers can vectorize themselves.
+*/
+static int countCharPortable(const char *text, int length, char c)
+{
+    const char *t, *end = text + length;
+    int count = 0;
+
+    for (t = text; t < end; t++)
+        count += *t == c;
+    return count;
+}
+
+static const char *findCharPortable(const char *text, int length, char c)
+{
+    return (const char *)memchr(text, c, length);
+}
+
+static const char *findCharBackwardPortable(const char *text, int length,
+        char c)
+{
+    const char *t;
+
+    for (t = text + length - 1; t >= text; t--)
+        if (*t == c)
+            return t;
+    return NULL;
+}
+
+static const char *findAnyCharPortable(const char *text, int length,
+        const char *chars, int nChars)
+{
+    const char *t, *c, *end = text + length;
+
+    for (t = text; t < end; t++)
+        for (c = chars; *c != '\0'; c++)
+            if (*t == *c)
+                return t;
+    return NULL;
+}
+
+static const char *findAnyCharBackwardPortable(const char *text, int length,
+        const char *chars, int nChars)
+{
+    const char *t, *c;
+
+    for (t = text + length - 1; t >= text; t--)
+        for (c = chars; *c != '\0'; c++)
+            if (*t == *c)
+                return t;
+    return NULL;
+}
+
+#ifdef SCAN_SSE2
+/*
+** SSE2 kernels, working on 16 characters at a time.  The text is read with
+** unaligned loads, and the odd characters left at the end are handed to the
+** portable kernels.  Counting accumulates the (-1) results of the byte
+** comparisons in byte lanes, so must fold them into the total every 255
+** blocks before the lanes can overflow.
+*/
+static int countCharSSE2(const char *text, int length, char c)
+{
+    const __m128i pattern = _mm_set1_epi8(c), zero = _mm_setzero_si128();
+    __m128i counts;
+    int i = 0, nBlocks, count = 0;
+
+    while (length - i >= 16) {
+        counts = zero;
+        for (nBlocks = 0; nBlocks < 255 && length - i >= 16; nBlocks++) {
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(pattern,
+                    _mm_loadu_si128((const __m128i *)(text + i))));
+            i += 16;
+        }
+        counts = _mm_sad_epu8(counts, zero);
+        count += _mm_cvtsi128_si32(counts) +
+                _mm_cvtsi128_si32(_mm_srli_si128(counts, 8));
+    }
+    return count + countCharPortable(text + i, length - i, c);
+}
+
+static const char *findCharSSE2(const char *text, int length, char c)
+{
+    const __m128i pattern = _mm_set1_epi8(c);
+    int i, mask;
+
+    for (i = 0; length - i >= 16; i += 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(pattern,
+                _mm_loadu_si128((const __m128i *)(text + i))));
+        if (mask != 0)
+            return text + i + __builtin_ctz(mask);
+    }
+    return findCharPortable(text + i, length - i, c);
+}
+
+static const char *findCharBackwardSSE2(const char *text, int length, char c)
+{
+    const __m128i pattern = _mm_set1_epi8(c);
+    int i, mask;
+
+    for (i = length; i >= 16; i -= 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(pattern,
+                _mm_loadu_si128((const __m128i *)(text + i - 16))));
+        if (mask != 0)
+            return text + i - 16 + 31 - __builtin_clz(mask);
+    }
+    return findCharBackwardPortable(text, i, c);
+}
+
+static const char *findAnyCharSSE2(const char *text, int length,
+        const char *chars, int nChars)
+{
+    __m128i patterns[MAX_VECTOR_CHARS], block, matches;
+    int i, j, mask;
+
+    for (j = 0; j < nChars; j++)
+        patterns[j] = _mm_set1_epi8(chars[j]);
+    for (i = 0; length - i >= 16; i += 16) {
+        block = _mm_loadu_si128((const __m128i *)(text + i));
+        matches = _mm_setzero_si128();
+        for (j = 0; j < nChars; j++)
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(patterns[j],
+                    block));
+        mask = _mm_movemask_epi8(matches);
+        if (mask != 0)
+            return text + i + __builtin_ctz(mask);
+    }
+    return findAnyCharPortable(text + i, length - i, chars, nChars);
+}
+
+static const char *findAnyCharBackwardSSE2(const char *text, int length,
+        const char *chars, int nChars)
+{
+    __m128i patterns[MAX_VECTOR_CHARS], block, matches;
+    int i, j, mask;
+
+    for (j = 0; j < nChars; j++)
+        patterns[j] = _mm_set1_epi8(chars[j]);
+    for (i = length; i >= 16; i -= 16) {
+        block = _mm_loadu_si128((const __m128i *)(text + i - 16));
+        matches = _mm_setzero_si128();
+        for (j = 0; j < nChars; j++)
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(patterns[j],
+                    block));
+        mask = _mm_movemask_epi8(matches);
+        if (mask != 0)
+            return text + i - 16 + 31 - __builtin_clz(mask);
+    }
+    return findAnyCharBackwardPortable(text, i, chars, nChars);
+}
+#endif /* SCAN_SSE2 */
+
+#ifdef SCAN_AVX2
+/*
+** AVX2 kernels, the same as the SSE2 ones but on 32 characters at a time.
+** The characters left at the end are done here one at a time rather than
+** passed on to the other kernels: running SSE instructions while the upper
+** halves of the AVX registers are in use costs more than it would save.
+*/
+__attribute__((target("avx2")))
+static int countCharAVX2(const char *text, int length, char c)
+{
+    const __m256i pattern = _mm256_set1_epi8(c);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i counts;
+    __m128i sums;
+    int i = 0, nBlocks, count = 0;
+
+    while (length - i >= 32) {
+        counts = zero;
+        for (nBlocks = 0; nBlocks < 255 && length - i >= 32; nBlocks++) {
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(pattern,
+                    _mm256_loadu_si256((const __m256i *)(text + i))));
+            i += 32;
+        }
+        counts = _mm256_sad_epu8(counts, zero);
+        sums = _mm_add_epi64(_mm256_castsi256_si128(counts),
+                _mm256_extracti128_si256(counts, 1));
+        count += _mm_cvtsi128_si32(sums) +
+                _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+    for (; i < length; i++)
+        count += text[i] == c;
+    return count;
+}
+
+__attribute__((target("avx2")))
+static const char *findCharAVX2(const char *text, int length, char c)
+{
+    const __m256i pattern = _mm256_set1_epi8(c);
+    int i;
+    unsigned mask;
+
+    for (i = 0; length - i >= 32; i += 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(pattern,
+                _mm256_loadu_si256((const __m256i *)(text + i))));
+        if (mask != 0)
+            return text + i + __builtin_ctz(mask);
+    }
+    for (; i < length; i++)
+        if (text[i] == c)
+            return text + i;
+    return NULL;
+}
+
+__attribute__((target("avx2")))
+static const char *findCharBackwardAVX2(const char *text, int length, char c)
+{
+    const __m256i pattern = _mm256_set1_epi8(c);
+    int i;
+    unsigned mask;
+
+    for (i = length; i >= 32; i -= 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(pattern,
+                _mm256_loadu_si256((const __m256i *)(text + i - 32))));
+        if (mask != 0)
+            return text + i - 32 + 31 - __builtin_clz(mask);
+    }
+    while (--i >= 0)
+        if (text[i] == c)
+            return text + i;
+    return NULL;
+}
+
+__attribute__((target("avx2")))
+static const char *findAnyCharAVX2(const char *text, int length,
+        const char *chars, int nChars)
+{
+    __m256i patterns[MAX_VECTOR_CHARS], block, matches;
+    int i, j;
+    unsigned mask;
+
+    for (j = 0; j < nChars; j++)
+        patterns[j] = _mm256_set1_epi8(chars[j]);
+    for (i = 0; length - i >= 32; i += 32) {
+        block = _mm256_loadu_si256((const __m256i *)(text + i));
+        matches = _mm256_setzero_si256();
+        for (j = 0; j < nChars; j++)
+            matches = _mm256_or_si256(matches,
+                    _mm256_cmpeq_epi8(patterns[j], block));
+        mask = _mm256_movemask_epi8(matches);
+        if (mask != 0)
+            return text + i + __builtin_ctz(mask);
+    }
+    for (; i < length; i++)
+        for (j = 0; j < nChars; j++)
+            if (text[i] == chars[j])
+                return text + i;
+    return NULL;
+}
+
+__attribute__((target("avx2")))
+static const char *findAnyCharBackwardAVX2(const char *text, int length,
+        const char *chars, int nChars)
+{
+    __m256i patterns[MAX_VECTOR_CHARS], block, matches;
+    int i, j;
+    unsigned mask;
+
+    for (j = 0; j < nChars; j++)
+        patterns[j] = _mm256_set1_epi8(chars[j]);
+    for (i = length; i >= 32; i -= 32) {
+        block = _mm256_loadu_si256((const __m256i *)(text + i - 32));
+        matches = _mm256_setzero_si256();
+        for (j = 0; j < nChars; j++)
+            matches = _mm256_or_si256(matches,
+                    _mm256_cmpeq_epi8(patterns[j], block));
+        mask = _mm256_movemask_epi8(matches);
+        if (mask != 0)
+            return text + i - 32 + 31 - __builtin_clz(mask);
+    }
+    while (--i >= 0)
+        for (j = 0; j < nChars; j++)
+            if (text[i] == chars[j])
+                return text + i;
+    return NULL;
+}
+#endif /* SCAN_AVX2 */
@@ -0,0 +1,46 @@
+/*******************************************************************************
+*                                                                              *
+* textScan.h -- Nirvana Editor character scanning kernels header               *
+*                                                                              *
+* Copyright 2026 The NEdit Developers                                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+* Nirvana Text Editor                                                          *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef NEDIT_TEXTSCAN_H_INCLUDED
+#define NEDIT_TEXTSCAN_H_INCLUDED
+
+/* Implementations of the scanning kernels, in order of preference (must be
+   kept in parallel with the KernelSets array in textScan.c) */
+enum scanKernelTypes {SCAN_KERNELS_PORTABLE, SCAN_KERNELS_SSE2,
+        SCAN_KERNELS_AVX2, N_SCAN_KERNEL_TYPES};
+
+int ScanCountChar(const char *text, int length, char c);
+const char *ScanFindChar(const char *text, int length, char c);
+const char *ScanFindCharBackward(const char *text, int length, char c);
+const char *ScanFindNthChar(const char *text, int length, char c, int n,
+        int *nFound);
+const char *ScanFindAnyChar(const char *text, int length, const char *chars);
+const char *ScanFindAnyCharBackward(const char *text, int length,
+        const char *chars);
+void ScanMarkChars(const char *text, int length, char present[256]);
+int ScanSelectKernels(int type);
+const char *ScanKernelsName(int type);
+
+#endif /* NEDIT_TEXTSCAN_H_INCLUDED */
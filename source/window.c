@@ -264,6 +264,8 @@ WindowInfo *CreateWindow(const char *name, char *geometry, int iconic)
     window->nPanes = 0;
     window->autoSaveCharCount = 0;
     window->autoSaveOpCount = 0;
+    window->backupJob = NULL;
+    window->backupPending = FALSE;
     window->undoOpCount = 0;
     window->undoMemUsed = 0;
     CLEAR_ALL_LOCKS(window->lockReasons);
@@ -745,7 +747,7 @@ WindowInfo *CreateWindow(const char *name, char *geometry, int iconic)
        with the text area widget.  This is done so the syntax highlighting
        modify callback can be called to synchronize the style buffer BEFORE
        the text display's callback is called upon to display a modification */
-    window->buffer = BufCreate();
+    window->buffer = BufCreateWithStorage(GetPrefBufferStorage());
     BufAddModifyCB(window->buffer, SyntaxHighlightModifyCB, window);
     
     /* Attach the buffer to the text widget, and add callbacks for modify */
@@ -986,6 +988,9 @@ void CloseWindow(WindowInfo *window)
     cancelTimeOut(&window->flashTimeoutID);
     cancelTimeOut(&window->markTimeoutID);
 
+    /* A backup still being written in the background finishes without it */
+    DetachBackgroundBackup(window);
+
     /* if this is the last window, or must be kept alive temporarily because
        it's running the macro calling us, don't close it, make it Untitled */
     if (keepWindow || (WindowList == window && window->next == NULL)) {
@@ -3301,6 +3306,8 @@ WindowInfo* CreateDocument(WindowInfo* shellWindow, const char* name)
     window->nPanes = 0;
     window->autoSaveCharCount = 0;
     window->autoSaveOpCount = 0;
+    window->backupJob = NULL;
+    window->backupPending = FALSE;
     window->undoOpCount = 0;
     window->undoMemUsed = 0;
     CLEAR_ALL_LOCKS(window->lockReasons);
@@ -3428,7 +3435,7 @@ WindowInfo* CreateDocument(WindowInfo* shellWindow, const char* name)
        with the text area widget.  This is done so the syntax highlighting
        modify callback can be called to synchronize the style buffer BEFORE
        the text display's callback is called upon to display a modification */
-    window->buffer = BufCreate();
+    window->buffer = BufCreateWithStorage(GetPrefBufferStorage());
     BufAddModifyCB(window->buffer, SyntaxHighlightModifyCB, window);
     
     /* Attach the buffer to the text widget, and add callbacks for modify */